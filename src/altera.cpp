@@ -8,6 +8,7 @@
 #include <string.h>
 
 #include <string>
+#include <vector>
 
 #include "jtag.hpp"
 #include "device.hpp"
@@ -240,34 +241,38 @@ int Altera::idCode()
 
 int Altera::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	/* +1 because send first cmd + len byte + 1 for rx due to a delay of
-	 * one bit
-	 */
-	int xfer_len = len + 1 + ((rx == NULL) ? 0 : 1);
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
-
-	if (tx != NULL) {
-		for (uint32_t i = 0; i < len; i++)
-			jtx[i] = RawParser::reverseByte(tx[i]);
-	}
-
-	shiftVIR(RawParser::reverseByte(cmd));
-	shiftVDR(jtx, (rx) ? jrx : NULL, 8 * xfer_len);
-
-	if (rx) {
-		for (uint32_t i = 0; i < len; i++) {
-			rx[i] = RawParser::reverseByte(jrx[i+1] >> 1) | (jrx[i+2] & 0x01);
-		}
-	}
+	return spi_put_batch({{cmd, tx, rx, len}});
+}
 
-	return 0;
+int Altera::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	return _jtag->spi_put_batch(xfers,
+		[&](const spi_xfer_t &x, uint8_t *rx) {
+			/* +1 because send first cmd + len byte + 1 for rx due to a
+			 * delay of one bit
+			 */
+			int xfer_len = x.len + 1 + ((rx == NULL) ? 0 : 1);
+			std::vector<uint8_t> jtx(xfer_len);
+
+			if (x.tx != NULL)
+				RawParser::reverseBytes(x.tx, jtx.data(), x.len);
+
+			shiftVIR(RawParser::reverseByte(x.cmd));
+			shiftVDR(jtx.data(), rx, 8 * xfer_len);
+		});
 }
 int Altera::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 {
 	return spi_put(tx[0], &tx[1], rx, len-1);
 }
 
+/* flash works while JTAG stays in idle: clocks are only sent */
+bool Altera::spi_delay(uint32_t us)
+{
+	_jtag->toggleClk_us(us);
+	return true;
+}
+
 int Altera::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 		uint32_t timeout, bool verbose)
 {
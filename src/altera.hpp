@@ -56,12 +56,17 @@ class Altera: public Device, SPIInterface {
 		bool unprotect_flash() override {
 			return SPIInterface::unprotect_flash();
 		}
+		void set_flash_mode(bool diff_prog, bool blind_prog) override {
+			SPIInterface::set_flash_mode(diff_prog, blind_prog);
+		}
 
 		int spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx,
 				uint32_t len) override;
 		int spi_put(uint8_t *tx, uint8_t *rx, uint32_t len) override;
+		int spi_put_batch(const std::vector<spi_xfer_t> &xfers) override;
 		int spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 				uint32_t timeout, bool verbose = false) override;
+		bool spi_delay(uint32_t us) override;
 
 	protected:
 		bool prepare_flash_access() override {return load_bridge();}
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include <stdexcept>
+#include <vector>
 
 #include "anlogic.hpp"
 #include "anlogicBitParser.hpp"
@@ -191,29 +192,28 @@ bool Anlogic::prepare_flash_access()
 
 int Anlogic::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	int xfer_len = len + 1;
-	if (rx)
-		xfer_len++;
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
-
-	jtx[0] = AnlogicBitParser::reverseByte(cmd);
-	if (tx != NULL) {
-		for (uint32_t i = 0; i < len; i++)
-			jtx[i+1] = AnlogicBitParser::reverseByte(tx[i]);
-	}
-
-	/* write anlogic command before sending packet */
-	uint8_t op = 0x60;
-	_jtag->shiftDR(&op, NULL, 8);
+	return spi_put_batch({{cmd, tx, rx, len}});
+}
 
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = AnlogicBitParser::reverseByte(jrx[i+1]>>1)
-				| (jrx[i+2]&0x01);
-	}
-	return 0;
+int Anlogic::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	return _jtag->spi_put_batch(xfers,
+		[&](const spi_xfer_t &x, uint8_t *rx) {
+			int xfer_len = x.len + 1;
+			if (rx)
+				xfer_len++;
+			std::vector<uint8_t> jtx(xfer_len);
+
+			jtx[0] = AnlogicBitParser::reverseByte(x.cmd);
+			if (x.tx != NULL)
+				AnlogicBitParser::reverseBytes(x.tx, &jtx[1], x.len);
+
+			/* write anlogic command before sending packet */
+			uint8_t op = 0x60;
+			_jtag->shiftDR(&op, NULL, 8);
+
+			_jtag->shiftDR(jtx.data(), rx, 8*xfer_len);
+		});
 }
 int Anlogic::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 {
@@ -223,21 +223,16 @@ int Anlogic::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	uint8_t jtx[xfer_len];
 	uint8_t jrx[xfer_len];
 
-	if (tx != NULL) {
-		for (uint32_t i = 0; i < len; i++)
-			jtx[i] = AnlogicBitParser::reverseByte(tx[i]);
-	}
+	if (tx != NULL)
+		AnlogicBitParser::reverseBytes(tx, jtx, len);
 
 	/* write anlogic command before sending packet */
 	uint8_t op = 0x60;
 	_jtag->shiftDR(&op, NULL, 8);
 
 	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = AnlogicBitParser::reverseByte(jrx[i]>>1) |
-				(jrx[i+1]&0x01);
-	}
+	if (rx != NULL)
+		AnlogicBitParser::reverseShiftedBytes(jrx, rx, len);
 	return 0;
 }
 int Anlogic::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
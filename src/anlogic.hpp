@@ -39,6 +39,9 @@ class Anlogic: public Device, SPIInterface {
 		bool unprotect_flash() override {
 			return SPIInterface::unprotect_flash();
 		}
+		void set_flash_mode(bool diff_prog, bool blind_prog) override {
+			SPIInterface::set_flash_mode(diff_prog, blind_prog);
+		}
 
 		/*!
 		 * \brief dump len byte from base_addr from SPI flash
@@ -53,6 +56,7 @@ class Anlogic: public Device, SPIInterface {
 		int spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx,
 			uint32_t len) override;
 		int spi_put(uint8_t *tx, uint8_t *rx, uint32_t len) override;
+		int spi_put_batch(const std::vector<spi_xfer_t> &xfers) override;
 		int spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 			uint32_t timeout, bool verbose=false) override;
 
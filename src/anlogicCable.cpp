@@ -46,7 +46,7 @@ enum analogicCableFreq {
 
 AnlogicCable::AnlogicCable(uint32_t clkHZ, uint8_t verbose):
 			_verbose(verbose),
-			dev_handle(NULL), usb_ctx(NULL), _tdi(0), _tms(0)
+			dev_handle(NULL), usb_ctx(NULL), _usb(NULL), _tdi(0), _tms(0)
 {
 	int ret;
 
@@ -71,6 +71,9 @@ AnlogicCable::AnlogicCable(uint32_t clkHZ, uint8_t verbose):
 		throw std::exception();
 	}
 
+	_usb = new UsbBulkEngine(usb_ctx, dev_handle, ANLOGICCABLE_WRITE_EP,
+		ANLOGICCABLE_READ_EP, 512);
+
 	if (setClkFreq(clkHZ) < 0) {
 		cerr << "Fail to set frequency" << endl;
 		throw std::exception();
@@ -79,6 +82,8 @@ AnlogicCable::AnlogicCable(uint32_t clkHZ, uint8_t verbose):
 
 AnlogicCable::~AnlogicCable()
 {
+	if (_usb)
+		delete _usb;
 	if (dev_handle)
 		libusb_close(dev_handle);
 	if (usb_ctx)
@@ -123,6 +128,12 @@ int AnlogicCable::setClkFreq(uint32_t clkHZ)
 		clkHZ = 90000;
 	}
 
+	/* configuration endpoint is not handled by _usb: wait for
+	 * pending transfers before changing frequency
+	 */
+	if (_usb->flush() < 0)
+		return -EXIT_FAILURE;
+
 	ret = libusb_bulk_transfer(dev_handle, ANLOGICCABLE_CONF_EP,
 			        buf, 2, &actual_length, 1000);
 	if (ret < 0) {
@@ -217,7 +228,7 @@ int AnlogicCable::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 
 int AnlogicCable::flush()
 {
-	return 0;
+	return _usb->flush();
 }
 
 int AnlogicCable::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
@@ -269,32 +280,38 @@ int AnlogicCable::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 		full_len -= xfer_len;
 	}
 
+	/* rx must be filled before return */
+	if (rx && _usb->flush() < 0)
+		return -EXIT_FAILURE;
+
 	return EXIT_SUCCESS;
 }
 
 int AnlogicCable::write(uint8_t *in_buf, uint8_t *out_buf, int len, int rd_len)
 {
-	int actual_length;
-	int ret = libusb_bulk_transfer(dev_handle, ANLOGICCABLE_WRITE_EP,
-			in_buf, len, &actual_length, 1000);
+	/* transfers are only queued: in_buf may be reused as soon as
+	 * this function returns. out_buf is filled by read completion
+	 */
+	int ret = _usb->write(in_buf, len);
 	if (ret < 0) {
 		cerr << "write: usb bulk write failed " << ret << endl;
 		return -EXIT_FAILURE;
 	}
 	/* all write must be followed by a read */
-	ret = libusb_bulk_transfer(dev_handle, ANLOGICCABLE_READ_EP,
-			in_buf, len, &actual_length, 1000);
+	ret = _usb->read(len, [out_buf, rd_len](const uint8_t *rx_buf, int rx_len) {
+			if (!out_buf)
+				return true;
+			for (int i = 0; i < rd_len && i < rx_len; i++) {
+				out_buf[i >> 3] >>= 1;
+				if ((rx_buf[i] >> 4) & 0x01)
+					out_buf[i >> 3] |= 0x80;
+			}
+			return true;
+		});
 	if (ret < 0) {
 		cerr << "write: usb bulk read failed " << ret << endl;
 		return -EXIT_FAILURE;
 	}
 
-	if (out_buf) {
-		for (int i = 0; i < rd_len; i++) {
-			out_buf[i >> 3] >>= 1;
-			if ((in_buf[i] >> 4) & 0x01)
-				out_buf[i >> 3] |= 0x80;
-		}
-	}
 	return len;
 }
@@ -9,6 +9,7 @@
 #include <libusb.h>
 
 #include "jtagInterface.hpp"
+#include "usbBulkEngine.hpp"
 
 /*!
  * \file AnlogicCable.hpp
@@ -49,6 +50,7 @@ class AnlogicCable : public JtagInterface {
 
     libusb_device_handle *dev_handle;
 	libusb_context *usb_ctx;
+	UsbBulkEngine *_usb; /*!< async bulk transfers */
 	uint8_t _tdi;
 	uint8_t _tms;
 };
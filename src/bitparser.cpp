@@ -23,9 +23,10 @@ using namespace std;
 #define display(...) \
 	do { if (_verbose) fprintf(stdout, __VA_ARGS__);} while(0)
 
-BitParser::BitParser(const string &filename, bool reverseOrder, bool verbose):
-	ConfigBitstreamParser(filename, ConfigBitstreamParser::BIN_MODE,
-	verbose), _reverseOrder(reverseOrder)
+BitParser::BitParser(const string &filename, bool reverseOrder, bool verbose,
+	bool stream):
+	ConfigBitstreamParser(filename, (stream) ? ConfigBitstreamParser::STREAM_MODE :
+	ConfigBitstreamParser::MMAP_MODE, verbose), _reverseOrder(reverseOrder)
 {
 }
 
@@ -42,27 +43,27 @@ int BitParser::parseHeader()
 	int pos, prev_pos;
 
 	/* Field 1 : misc header */
-	length = *(uint16_t *)&_raw_data[0];
+	length = *(const uint16_t *)&_raw_ptr[0];
 	length = ntohs(length);
 	pos_data += length + 2;
 
-	length = *(uint16_t *)&_raw_data[pos_data];
+	length = *(const uint16_t *)&_raw_ptr[pos_data];
 	length = ntohs(length);
 	pos_data += 2;
 
 	while (1) {
 		/* type */
 		uint8_t type;
-		type = (uint8_t)_raw_data[pos_data++];
+		type = (uint8_t)_raw_ptr[pos_data++];
 
 		if (type != 'e') {
-			length = *(uint16_t *)&_raw_data[pos_data];
+			length = *(const uint16_t *)&_raw_ptr[pos_data];
 			length = ntohs(length);
 			pos_data += 2;
 		} else {
 			length = 4;
 		}
-		tmp = _raw_data.substr(pos_data, length);
+		tmp = string(&_raw_ptr[pos_data], length);
 		pos_data += length;
 
 		switch (type) {
@@ -109,15 +110,19 @@ int BitParser::parse()
 	/* process all field */
 	int pos = parseHeader();
 
-	/* rest of the file is data to send */
-	_bit_data.resize(_raw_data.size() - pos);
-	std::move(_raw_data.begin() + pos, _raw_data.end(), _bit_data.begin());
-	_bit_length = _bit_data.size();
+	/* rest of the file is data to send (streamed part included) */
+	const int mem_len = _raw_len - pos;
+	_bit_length = mem_len + _stream_len;
+	_stream_reverse = _reverseOrder;
 
 	if (_reverseOrder) {
-		for (int i = 0; i < _bit_length; i++) {
-			_bit_data[i] = reverseByte(_bit_data[i]);
-		}
+		/* reversed content is stored in _bit_data */
+		_bit_data.resize(mem_len);
+		reverseBytes((const uint8_t *)&_raw_ptr[pos], (uint8_t *)&_bit_data[0],
+			mem_len);
+	} else {
+		/* file content used in place */
+		_payload = (uint8_t *)&_raw_ptr[pos];
 	}
 
 	/* convert size to bit */
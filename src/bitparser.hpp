@@ -14,7 +14,16 @@
 
 class BitParser: public ConfigBitstreamParser {
 	public:
-		BitParser(const std::string &filename, bool reverseOrder, bool verbose = false);
+		/*!
+		 * \brief constructor
+		 * \param[in] filename: bitstream file
+		 * \param[in] reverseOrder: reverse each byte
+		 * \param[in] verbose: verbose mode
+		 * \param[in] stream: gzip file decompressed while data are
+		 *            consumed with nextData()
+		 */
+		BitParser(const std::string &filename, bool reverseOrder,
+			bool verbose = false, bool stream = false);
 		~BitParser();
 		int parse() override;
 
@@ -68,6 +68,9 @@ void CH552_jtag::init_internal(const FTDIpp_MPSSE::mpsse_bit_config &cable)
 	display("%x\n", cable.bit_high_val);
 	display("%x\n", cable.bit_high_dir);
 
+	/* CH552 firmware expects one USB packet per command */
+	_buffer_size = _ftdi->max_packet_size;
+
 	init(5, 0xfb, BITMODE_MPSSE);
 	ftdi_set_event_char(_ftdi, 0, 0);
 	ftdi_set_error_char(_ftdi, 0, 0);
@@ -35,7 +35,8 @@ enum datalink_cmd {
 	DAP_RESETTARGET   = 0x0A,  // reset the target
 	DAP_SWJ_CLK       = 0x11,  // Select maximum frequency
 	DAP_SWJ_SEQUENCE  = 0x12,  // Generate TMS sequence
-	DAP_JTAG_SEQUENCE = 0x14   // Generate TMS, TDI and capture TDO Sequence
+	DAP_JTAG_SEQUENCE = 0x14,  // Generate TMS, TDI and capture TDO Sequence
+	DAP_EXECUTE_COMMANDS = 0x7F  // Execute multiple commands in one packet
 };
 
 enum cmsisdap_connect_mode {
@@ -90,62 +91,18 @@ enum cmsisdap_status {
 
 CmsisDAP::CmsisDAP(int vid, int pid, uint8_t verbose):_verbose(verbose),
 		_device_idx(0),  _vid(vid), _pid(pid),
-		_serial_number(L""), _dev(NULL), _num_tms(0), _is_connect(false)
+		_serial_number(L""), _dev(NULL), _usb_ctx(NULL), _usb_handle(NULL),
+		_usb_intf(0), _ep_out(0), _ep_in(0), _packet_size(64),
+		_packet_count(1), _execute_cmd(false), _num_tms(0), _is_connect(false)
 {
-	std::vector<struct hid_device_info *> dev_found;
 	_ll_buffer = (unsigned char *)malloc(sizeof(unsigned char) * 65);
 	if (!_ll_buffer)
 		std::runtime_error("internal buffer allocation failed");
 	_buffer = _ll_buffer+2;
 
-	/* only hid support */
-	struct hid_device_info *devs, *cur_dev;
-
-	if (hid_init() != 0) {
-		throw std::runtime_error("hidapi init failed");
-	}
-
-	/* search for HID compatible devices
-	 * if vid/pid are 0 this function return all;
-	 * if vid/pid are >0 only one (or 0) device returned
-	 */
-	devs = hid_enumerate(vid, pid);
-
-	for (cur_dev = devs; NULL != cur_dev; cur_dev = cur_dev->next) {
-		dev_found.push_back(cur_dev);
-	}
-
-	/* no devices: stop */
-	if (dev_found.empty()) {
-		hid_exit();
-		throw std::runtime_error("No device found");
-	}
-	/* more than one device: can't continue without more information */
-	if (dev_found.size() > 1) {
-		hid_exit();
-		throw std::runtime_error(
-				"Error: more than one device. Please provides VID/PID");
-	}
-
-	printInfo("Found " + std::to_string(dev_found.size()) + " compatible device:");
-	for (size_t i = 0; i < dev_found.size(); i++) {
-		char val[256];
-		snprintf(val, sizeof(val), "\t0x%04x 0x%04x %ls",
-				dev_found[i]->vendor_id,
-				dev_found[i]->product_id,
-				dev_found[i]->product_string);
-		printInfo(val);
-	}
-
-	/* store params about device to use */
-	_vid = dev_found[_device_idx]->vendor_id;
-	_pid = dev_found[_device_idx]->product_id;
-	if (dev_found[_device_idx]->serial_number != NULL)
-		_serial_number = wstring(dev_found[_device_idx]->serial_number);
-	/* open the device */
-	_dev = hid_open_path(dev_found[_device_idx]->path);
-	/* cleanup enumeration */
-	hid_free_enumeration(devs);
+	/* CMSIS-DAP v2 (bulk) is preferred, v1 (HID) otherwise */
+	if (!open_bulk(vid, pid))
+		open_hid(vid, pid);
 
 	if (verbose) {
 		display_info(INFO_ID_VID               , DAPLINK_INFO_STRING);
@@ -185,8 +142,7 @@ CmsisDAP::CmsisDAP(int vid, int pid, uint8_t verbose):_verbose(verbose),
 	memset(_buffer, 0, 63);
 	int res = read_info(INFO_ID_HWCAP, _buffer, 63);
 	if (res < 0) {
-		hid_close(_dev);
-		hid_exit();
+		close_device();
 		char t[256];
 		snprintf(t, sizeof(t), "Error %d for command %d\n", res, INFO_ID_HWCAP);
 		throw std::runtime_error(t);
@@ -195,15 +151,38 @@ CmsisDAP::CmsisDAP(int vid, int pid, uint8_t verbose):_verbose(verbose),
 	if (verbose)
 		printf("Hardware cap %02x %02x %02x\n", _buffer[0], _buffer[1], _buffer[2]);
 	if (!(_buffer[2] & (1 << 1))) {
-		hid_close(_dev);
-		hid_exit();
+		close_device();
 		throw std::runtime_error("JTAG is not supported by the probe");
 	}
 
+	/* packet size and number of packets the probe is able to buffer:
+	 * up to _packet_count sequences are sent before reading responses
+	 */
+	uint8_t info[65];
+	if (read_info(INFO_ID_MAX_PKT_SZ, info, sizeof(info)) == 2) {
+		int size = info[2] | (info[3] << 8);
+		if (size >= 64)
+			set_packet_size(size);
+	}
+	if (read_info(INFO_ID_MAX_PKT_CNT, info, sizeof(info)) == 1 && info[2] > 0)
+		_packet_count = info[2];
+
+	/* DAP_ExecuteCommands is available since firmware 1.1 */
+	memset(info, 0, sizeof(info));
+	res = read_info(INFO_ID_FWVERS, info, sizeof(info) - 1);
+	if (res > 0) {
+		int major, minor;
+		if (sscanf((const char *)&info[2], "%d.%d", &major, &minor) == 2)
+			_execute_cmd = (major > 1 || (major == 1 && minor >= 1));
+	}
+
+	if (verbose)
+		printf("packet size %d count %zu execute commands %d\n",
+			_packet_size, _packet_count, _execute_cmd);
+
 	/* send connect */
 	if (dapConnect() != 1) {
-		hid_close(_dev);
-		hid_exit();
+		close_device();
 		throw std::runtime_error("DAP connection in JTAG mode failed");
 	}
 }
@@ -215,14 +194,223 @@ CmsisDAP::~CmsisDAP()
 	 */
 	if (_is_connect)
 		dapDisconnect();
-	if (_dev)
-		hid_close(_dev);
-	hid_exit();
+	close_device();
 
 	if (_ll_buffer)
 		free(_ll_buffer);
 }
 
+bool CmsisDAP::open_bulk(int vid, int pid)
+{
+	typedef struct {
+		libusb_device *dev;
+		int intf;
+		uint8_t ep_out;
+		uint8_t ep_in;
+		int max_packet_size;
+	} bulk_dev_t;
+	std::vector<bulk_dev_t> dev_found;
+	libusb_device **dev_list;
+
+	if (libusb_init(&_usb_ctx) < 0) {
+		_usb_ctx = NULL;
+		return false;
+	}
+
+	ssize_t nb_dev = libusb_get_device_list(_usb_ctx, &dev_list);
+	for (ssize_t i = 0; i < nb_dev; i++) {
+		struct libusb_device_descriptor desc;
+		struct libusb_config_descriptor *config;
+		if (libusb_get_device_descriptor(dev_list[i], &desc) != 0)
+			continue;
+		if ((vid != 0 && desc.idVendor != vid) ||
+				(pid != 0 && desc.idProduct != pid))
+			continue;
+		if (libusb_get_active_config_descriptor(dev_list[i], &config) != 0)
+			continue;
+
+		/* v2 interface: vendor class, first endpoint is bulk OUT,
+		 * second bulk IN and interface string contains "CMSIS-DAP"
+		 */
+		for (int intf = 0; intf < config->bNumInterfaces; intf++) {
+			const struct libusb_interface_descriptor *alt =
+				&config->interface[intf].altsetting[0];
+			if (alt->bInterfaceClass != LIBUSB_CLASS_VENDOR_SPEC ||
+					alt->bNumEndpoints < 2 || alt->iInterface == 0)
+				continue;
+			const struct libusb_endpoint_descriptor *out = &alt->endpoint[0];
+			const struct libusb_endpoint_descriptor *in = &alt->endpoint[1];
+			if ((out->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) !=
+					LIBUSB_TRANSFER_TYPE_BULK ||
+					(in->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) !=
+					LIBUSB_TRANSFER_TYPE_BULK ||
+					(out->bEndpointAddress & LIBUSB_ENDPOINT_IN) ||
+					!(in->bEndpointAddress & LIBUSB_ENDPOINT_IN))
+				continue;
+
+			libusb_device_handle *handle;
+			if (libusb_open(dev_list[i], &handle) != 0)
+				continue;
+			unsigned char name[256];
+			int ret = libusb_get_string_descriptor_ascii(handle,
+				alt->iInterface, name, sizeof(name) - 1);
+			libusb_close(handle);
+			if (ret <= 0)
+				continue;
+			name[ret] = '\0';
+			if (!strstr((const char *)name, "CMSIS-DAP"))
+				continue;
+
+			dev_found.push_back({dev_list[i], alt->bInterfaceNumber,
+				out->bEndpointAddress, in->bEndpointAddress,
+				in->wMaxPacketSize});
+			break;
+		}
+		libusb_free_config_descriptor(config);
+	}
+
+	/* more than one device: can't continue without more information */
+	if (dev_found.size() > 1) {
+		libusb_free_device_list(dev_list, 1);
+		libusb_exit(_usb_ctx);
+		_usb_ctx = NULL;
+		throw std::runtime_error(
+				"Error: more than one device. Please provides VID/PID");
+	}
+
+	/* no v2 device or open fails: fallback to HID */
+	if (dev_found.empty() ||
+			libusb_open(dev_found[0].dev, &_usb_handle) != 0) {
+		if (nb_dev >= 0)
+			libusb_free_device_list(dev_list, 1);
+		libusb_exit(_usb_ctx);
+		_usb_ctx = NULL;
+		_usb_handle = NULL;
+		return false;
+	}
+	libusb_free_device_list(dev_list, 1);
+
+	_usb_intf = dev_found[0].intf;
+	if (libusb_claim_interface(_usb_handle, _usb_intf) != 0) {
+		printWarn("CMSIS-DAP v2: can't claim interface, try HID");
+		libusb_close(_usb_handle);
+		libusb_exit(_usb_ctx);
+		_usb_handle = NULL;
+		_usb_ctx = NULL;
+		return false;
+	}
+	_ep_out = dev_found[0].ep_out;
+	_ep_in = dev_found[0].ep_in;
+	set_packet_size(dev_found[0].max_packet_size);
+
+	/* store params about device to use */
+	struct libusb_device_descriptor desc;
+	libusb_get_device_descriptor(libusb_get_device(_usb_handle), &desc);
+	_vid = desc.idVendor;
+	_pid = desc.idProduct;
+	unsigned char str[256];
+	if (desc.iSerialNumber != 0) {
+		int ret = libusb_get_string_descriptor_ascii(_usb_handle,
+			desc.iSerialNumber, str, sizeof(str));
+		if (ret > 0)
+			_serial_number = wstring(str, str + ret);
+	}
+	int ret = 0;
+	if (desc.iProduct != 0)
+		ret = libusb_get_string_descriptor_ascii(_usb_handle,
+			desc.iProduct, str, sizeof(str) - 1);
+	str[(ret > 0) ? ret : 0] = '\0';
+
+	printInfo("Found 1 compatible device (CMSIS-DAP v2):");
+	char val[256];
+	snprintf(val, sizeof(val), "\t0x%04x 0x%04x %s", _vid, _pid, str);
+	printInfo(val);
+
+	return true;
+}
+
+void CmsisDAP::open_hid(int vid, int pid)
+{
+	std::vector<struct hid_device_info *> dev_found;
+	struct hid_device_info *devs, *cur_dev;
+
+	if (hid_init() != 0) {
+		throw std::runtime_error("hidapi init failed");
+	}
+
+	/* search for HID compatible devices
+	 * if vid/pid are 0 this function return all;
+	 * if vid/pid are >0 only one (or 0) device returned
+	 */
+	devs = hid_enumerate(vid, pid);
+
+	for (cur_dev = devs; NULL != cur_dev; cur_dev = cur_dev->next) {
+		dev_found.push_back(cur_dev);
+	}
+
+	/* no devices: stop */
+	if (dev_found.empty()) {
+		hid_exit();
+		throw std::runtime_error("No device found");
+	}
+	/* more than one device: can't continue without more information */
+	if (dev_found.size() > 1) {
+		hid_exit();
+		throw std::runtime_error(
+				"Error: more than one device. Please provides VID/PID");
+	}
+
+	printInfo("Found " + std::to_string(dev_found.size()) + " compatible device:");
+	for (size_t i = 0; i < dev_found.size(); i++) {
+		char val[256];
+		snprintf(val, sizeof(val), "\t0x%04x 0x%04x %ls",
+				dev_found[i]->vendor_id,
+				dev_found[i]->product_id,
+				dev_found[i]->product_string);
+		printInfo(val);
+	}
+
+	/* store params about device to use */
+	_vid = dev_found[_device_idx]->vendor_id;
+	_pid = dev_found[_device_idx]->product_id;
+	if (dev_found[_device_idx]->serial_number != NULL)
+		_serial_number = wstring(dev_found[_device_idx]->serial_number);
+	/* open the device */
+	_dev = hid_open_path(dev_found[_device_idx]->path);
+	/* cleanup enumeration */
+	hid_free_enumeration(devs);
+}
+
+void CmsisDAP::close_device()
+{
+	if (_usb_handle) {
+		libusb_release_interface(_usb_handle, _usb_intf);
+		libusb_close(_usb_handle);
+		_usb_handle = NULL;
+	}
+	if (_usb_ctx) {
+		libusb_exit(_usb_ctx);
+		_usb_ctx = NULL;
+	}
+	if (_dev) {
+		hid_close(_dev);
+		_dev = NULL;
+	}
+	hid_exit();
+}
+
+void CmsisDAP::set_packet_size(int size)
+{
+	/* 65: HID report ID + 64 bytes, min size used by info requests */
+	int ll_size = (size + 1 > 65) ? size + 1 : 65;
+	unsigned char *ptr = (unsigned char *)realloc(_ll_buffer, ll_size);
+	if (!ptr)
+		throw std::runtime_error("internal buffer allocation failed");
+	_ll_buffer = ptr;
+	_buffer = _ll_buffer + 2;
+	_packet_size = size;
+}
+
 /* send connect instruction (0x02) to switch
  * in JTAG mode (0x02)
  */
@@ -326,6 +514,9 @@ int CmsisDAP::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 }
 
 /* 0x14 + number of sequence + seq1 details + tdi + seq2 details + tdi + ...
+ * up to _packet_count packets are sent before reading responses.
+ * With DAP_ExecuteCommands pending TMS states are sent in the first packet:
+ * 0x7F + 2 + 0x12 + number of TMS + TMS + 0x14 + number of sequence + ...
  */
 int CmsisDAP::writeJtagSequence(uint8_t tms, uint8_t *tx, uint8_t *rx,
 		uint32_t len, bool end)
@@ -343,7 +534,51 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, uint8_t *tx, uint8_t *rx,
 	int pos = 1;      // 0: num of sequence, 1: seq1 detail
 	int xfer_rest = real_len;  // main loop
 
-	flush();  // force TMS flush to free _buffer
+	/* DAP_SWJ_SEQUENCE command with pending TMS states, merged
+	 * with the first sequence packet
+	 */
+	uint8_t prefix[2 + 32];
+	int prefix_len = 0;
+	if (_num_tms > 0 && _execute_cmd && (real_len > 0 || end)) {
+		prefix[0] = DAP_SWJ_SEQUENCE;
+		prefix[1] = (uint8_t)(_num_tms & 0xff);
+		prefix_len = 2 + (_num_tms + 7) / 8;
+		memcpy(&prefix[2], &_buffer[1], prefix_len - 2);
+		_num_tms = 0;
+	} else {
+		flush();  // force TMS flush to free _buffer
+	}
+
+	/* extra: 0x7F + 2 + prefix before 0x14 (first packet only) */
+	int extra = (prefix_len) ? 2 + prefix_len : 0;
+	uint8_t *seq = _ll_buffer + 2 + extra;  // sequences buffer
+	int max_pos = _packet_size - 1 - extra;  // sequences buffer size
+
+	/* send seq_num sequences stored in seq and add a pending response */
+	auto send_sequences = [&](uint8_t *read_ptr, int read_len,
+			uint8_t *bit_ptr, uint8_t bit_mask) -> int {
+		seq[0] = seq_num;  // set number of sequences
+		_ll_buffer[1 + extra] = DAP_JTAG_SEQUENCE;
+		if (extra) {
+			_ll_buffer[1] = DAP_EXECUTE_COMMANDS;
+			_ll_buffer[2] = 2;
+			memcpy(&_ll_buffer[3], prefix, prefix_len);
+		}
+		if (xfer_write(1 + extra + pos) <= 0)
+			return -1;
+		/* response: [0x7F, 2, 0x12, status,] 0x14, status, tdo */
+		_pending.push_back({(uint8_t)((extra) ? DAP_EXECUTE_COMMANDS :
+				DAP_JTAG_SEQUENCE), 2 + ((extra) ? 4 : 0),
+				read_ptr, read_len, bit_ptr, bit_mask});
+		/* next packets: only sequences */
+		extra = 0;
+		seq = _buffer;
+		max_pos = _packet_size - 1;
+		/* probe buffer full: wait for the oldest response */
+		if (_pending.size() >= _packet_count)
+			return read_response();
+		return 1;
+	};
 
 	while (xfer_rest > 0) {
 		if (xfer_rest >= 64) {  // fully fill one sequence
@@ -354,28 +589,28 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, uint8_t *tx, uint8_t *rx,
 			xfer_bit_len = xfer_rest;
 		}
 
-		/* buffer is 65bits with
+		/* buffer is _packet_size + 1 bytes with
 		 * [0]   : hid
 		 * [1]   : cmsisdap operation
 		 * [2]   : number of sequence
-		 * [64:3]: sequence with
+		 * [n:3]: sequence with
 		 *    [n]        : sequence infos
 		 *    [n+m+1:n+1]: data
-		 * So only 62 bits are available to send sequences
+		 * So only max_pos - 1 bytes are available to send sequences
 		 * and 64bits (full sequence) mean 8bits
-		 * => one sequence == 9Bytes and 9*7 == 63
-		 * then we have 6 * 8 fully filled sequence + one up to 56bits
+		 * => one sequence == 9Bytes. Last sequence is shrinked to
+		 * fill the packet
 		 */
-		if (xfer_byte_len + 1 + pos > 63) {
-			xfer_byte_len = 63 - pos - 1;  // number of free bytes
+		if (xfer_byte_len + 1 + pos > max_pos) {
+			xfer_byte_len = max_pos - pos - 1;  // number of free bytes
 			xfer_bit_len = xfer_byte_len * 8;
 		}
 
 		/* update sequence info with number of bit */
-		_buffer[pos++] = seq_info_base |
+		seq[pos++] = seq_info_base |
 			DAP_JTAG_SEQ_NB_TCK((xfer_bit_len == 64?0:xfer_bit_len));
 		if (tx) {  // use tx only if not NULL
-			memcpy(&_buffer[pos], (unsigned char *)tx_ptr, xfer_byte_len);
+			memcpy(&seq[pos], (unsigned char *)tx_ptr, xfer_byte_len);
 			tx_ptr += xfer_byte_len;
 		}
 		xfer_rest -= xfer_bit_len;  // update remaining number of bit
@@ -384,17 +619,17 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, uint8_t *tx, uint8_t *rx,
 		byte_to_read += xfer_byte_len;  // update read lenght
 
 		/* when it's the last sequence or
-		 * buffer is fully filled
+		 * buffer is fully filled (no room for a sequence
+		 * with one byte or 255 sequences)
 		 * => flush
 		 * if it's the last sequence and end is true, don't do anything
 		 * here -> see bellow
 		 */
-		if ((!end && xfer_rest == 0) || seq_num == 7) {
-			_buffer[0] = seq_num;  // set number of sequences
-			ret = xfer(DAP_JTAG_SEQUENCE, pos,
-					(rx) ? rx_ptr: NULL, byte_to_read);
-			if (ret <= 0) {
+		if ((!end && xfer_rest == 0) || seq_num == 255 || pos + 2 > max_pos) {
+			ret = send_sequences((rx) ? rx_ptr : NULL, byte_to_read, NULL, 0);
+			if (ret < 0) {
 				printError("writeTDI: failed to send sequence");
+				_pending.clear();
 				return ret;
 			}
 			if (rx)  // if read: move pointer to the next position
@@ -413,25 +648,24 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, uint8_t *tx, uint8_t *rx,
 	 * as last bit to send
 	 */
 	if (end) {
-		byte_to_read++;   // residual (or 0) from previous iter + 1 Byte
-		uint8_t val[byte_to_read];
-		_buffer[0] = seq_num + 1;
-		_buffer[pos++] = ((rx) ? DAP_JTAG_SEQ_TDO_CAPTURE : 0) |
+		seq_num++;
+		seq[pos++] = ((rx) ? DAP_JTAG_SEQ_TDO_CAPTURE : 0) |
 								  DAP_JTAG_SEQ_TMS_SHIFT(0x01&(!tms)) |
 								  DAP_JTAG_SEQ_NB_TCK(1);
-		_buffer[pos++] = (tx[(real_len) >> 3] & (1 << (real_len & 0x07))) ? 1 : 0;
-		ret = xfer(DAP_JTAG_SEQUENCE, pos, (rx) ? val: NULL, byte_to_read);
-		if (ret <= 0) {
+		seq[pos++] = (tx && (tx[(real_len) >> 3] & (1 << (real_len & 0x07)))) ? 1 : 0;
+		/* residual (or 0) from previous iter + last bit in an extra byte */
+		ret = send_sequences((rx) ? rx_ptr : NULL, byte_to_read,
+				(rx) ? &rx[real_len >> 3] : NULL, 1 << (real_len & 0x07));
+		if (ret < 0) {
 			printError("writeTDI: failed to send last sequence");
+			_pending.clear();
 			return ret;
 		}
-		if (rx) {
-			memcpy(rx_ptr, val, byte_to_read-1);
-			if (val[byte_to_read-1] & 0x01)
-				rx[real_len >> 3] |= 1 << ((real_len) & 0x07);
-			else
-				rx[real_len >> 3] &= ~(1 << ((real_len) & 0x07));
-		}
+	}
+
+	if (read_all_responses() < 0) {
+		printError("writeTDI: failed to read sequence response");
+		return -1;
 	}
 
 	return len;
@@ -481,22 +715,19 @@ int CmsisDAP::flush()
 int CmsisDAP::xfer(uint8_t instruction, int tx_len,
 		uint8_t *rx_buff, int rx_len)
 {
-	(void)tx_len;
-
-	_ll_buffer[0] = 0;
 	_ll_buffer[1] = instruction;
 
-	int ret = hid_write(_dev, _ll_buffer, 65);
-	if (ret == -1) {
+	int ret = xfer_write(tx_len + 1);
+	if (ret <= 0) {
 		printf("Error\n");
 		return ret;
 	}
 
-	ret = hid_read_timeout(_dev, _ll_buffer, 65, 1000);
+	ret = xfer_read();
 	if (ret <= 0) {
 		if (ret == 0)
 			printError("Error timeout\n");
-		else if (ret == -1)
+		else
 			printError("Error comm\n");
 		return ret;
 	}
@@ -518,21 +749,17 @@ int CmsisDAP::xfer(uint8_t instruction, int tx_len,
  */
 int CmsisDAP::xfer(int tx_len, uint8_t *rx_buff, int rx_len)
 {
-	(void)tx_len;
-
-	_ll_buffer[0] = 0;
-
-	int ret = hid_write(_dev, _ll_buffer, 65);
-	if (ret == -1) {
+	int ret = xfer_write(tx_len);
+	if (ret <= 0) {
 		printf("Error\n");
 		return ret;
 	}
 
-	ret = hid_read_timeout(_dev, _ll_buffer, 65, 1000);
+	ret = xfer_read();
 	if (ret <= 0) {
 		if (ret == 0)
 			printf("Error timeout\n");
-		else if (ret == -1)
+		else
 			printf("Error comm\n");
 		return ret;
 	}
@@ -543,6 +770,84 @@ int CmsisDAP::xfer(int tx_len, uint8_t *rx_buff, int rx_len)
 	return ret;
 }
 
+/* HID: report ID (0) + full report
+ * bulk: only packet content
+ */
+int CmsisDAP::xfer_write(int tx_len)
+{
+	if (_usb_handle) {
+		int actual_length;
+		int ret = libusb_bulk_transfer(_usb_handle, _ep_out,
+				_ll_buffer + 1, tx_len, &actual_length, 1000);
+		if (ret < 0 || actual_length != tx_len)
+			return -1;
+		return tx_len;
+	}
+
+	_ll_buffer[0] = 0;
+	int ret = hid_write(_dev, _ll_buffer, _packet_size + 1);
+	if (ret == -1)
+		return ret;
+	return tx_len;
+}
+
+int CmsisDAP::xfer_read()
+{
+	if (_usb_handle) {
+		int actual_length = 0;
+		int ret = libusb_bulk_transfer(_usb_handle, _ep_in,
+				_ll_buffer, _packet_size, &actual_length, 1000);
+		if (ret == LIBUSB_ERROR_TIMEOUT)
+			return 0;
+		if (ret < 0)
+			return -1;
+		return actual_length;
+	}
+
+	return hid_read_timeout(_dev, _ll_buffer, _packet_size + 1, 1000);
+}
+
+int CmsisDAP::read_response()
+{
+	pending_t resp = _pending.front();
+	_pending.pop_front();
+
+	int ret = xfer_read();
+	if (ret <= 0) {
+		printError((ret == 0) ? "Error timeout" : "Error comm");
+		return -1;
+	}
+	/* instruction and status (ExecuteCommands: SWJ sequence status too) */
+	if (_ll_buffer[0] != resp.cmd || _ll_buffer[resp.offset - 1] != DAP_OK ||
+			(resp.cmd == DAP_EXECUTE_COMMANDS && _ll_buffer[3] != DAP_OK)) {
+		printError("Error: command error");
+		return -1;
+	}
+
+	if (resp.rx)
+		memcpy(resp.rx, &_ll_buffer[resp.offset], resp.len);
+	/* last bit received in an extra byte */
+	if (resp.bit_ptr) {
+		if (_ll_buffer[resp.offset + resp.len] & 0x01)
+			*resp.bit_ptr |= resp.bit_mask;
+		else
+			*resp.bit_ptr &= ~resp.bit_mask;
+	}
+
+	return ret;
+}
+
+int CmsisDAP::read_all_responses()
+{
+	while (!_pending.empty()) {
+		if (read_response() < 0) {
+			_pending.clear();
+			return -1;
+		}
+	}
+	return 0;
+}
+
 int CmsisDAP::read_info(uint8_t info, uint8_t *rd_info, int max_len)
 {
 	_ll_buffer[1] = DAP_INFO;
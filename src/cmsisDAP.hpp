@@ -9,6 +9,7 @@
 #include <hidapi.h>
 #include <libusb.h>
 
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -75,6 +76,29 @@ class CmsisDAP: public JtagInterface {
 		bool isFull() override {return false;}
 
 	private:
+		/*!
+		 * \brief search for a CMSIS-DAP v2 (vendor class, bulk endpoints)
+		 *        interface and open it
+		 * \param[in] vid: vendor id (0: any)
+		 * \param[in] pid: product id (0: any)
+		 * \return false when no v2 interface is found
+		 */
+		bool open_bulk(int vid, int pid);
+		/*!
+		 * \brief search for a CMSIS-DAP v1 (HID) device and open it
+		 * \param[in] vid: vendor id (0: any)
+		 * \param[in] pid: product id (0: any)
+		 */
+		void open_hid(int vid, int pid);
+		/*!
+		 * \brief close HID or bulk device and free contexts
+		 */
+		void close_device();
+		/*!
+		 * \brief update packet size and resize internal buffer
+		 * \param[in] size: packet size (in byte)
+		 */
+		void set_packet_size(int size);
 		/*!
 		 * \brief connect device in JTAG mode
 		 * \return 1 if success <= 0 otherwhise
@@ -91,6 +115,27 @@ class CmsisDAP: public JtagInterface {
 		int xfer(int tx_len, uint8_t *rx_buff, int rx_len);
 		int xfer(uint8_t instruction, int tx_len,
 				uint8_t *rx_buff, int rx_len);
+		/*!
+		 * \brief send a packet starting at _ll_buffer[1]
+		 * \param[in] tx_len: packet length (instruction included)
+		 * \return <= 0 if something wrong, tx_len otherwise
+		 */
+		int xfer_write(int tx_len);
+		/*!
+		 * \brief read one response packet into _ll_buffer
+		 * \return 0 on timeout, < 0 on error, packet length otherwise
+		 */
+		int xfer_read();
+		/*!
+		 * \brief read oldest pending response and copy TDO bits
+		 * \return < 0 if something wrong
+		 */
+		int read_response();
+		/*!
+		 * \brief read all pending responses
+		 * \return < 0 if something wrong
+		 */
+		int read_all_responses();
 
 		void display_info(uint8_t info, uint8_t type);
 		int writeJtagSequence(uint8_t tms, uint8_t *tx, uint8_t *rx,
@@ -103,6 +148,25 @@ class CmsisDAP: public JtagInterface {
 		std::wstring _serial_number;  /**< device serial number */
 
 		hid_device *_dev;          /**< hid device used to communicate */
+		libusb_context *_usb_ctx;  /**< CMSIS-DAP v2 libusb context */
+		libusb_device_handle *_usb_handle; /**< CMSIS-DAP v2 device */
+		int _usb_intf;             /**< CMSIS-DAP v2 interface */
+		uint8_t _ep_out;           /**< CMSIS-DAP v2 bulk OUT endpoint */
+		uint8_t _ep_in;            /**< CMSIS-DAP v2 bulk IN endpoint */
+		int _packet_size;          /**< probe packet size */
+		size_t _packet_count;      /**< packets buffered by the probe */
+		bool _execute_cmd;         /**< DAP_ExecuteCommands support */
+
+		/* sent packets waiting for their response */
+		typedef struct {
+			uint8_t cmd;      /**< expected instruction in response */
+			int offset;       /**< TDO offset in response */
+			uint8_t *rx;      /**< TDO destination (NULL: no read) */
+			int len;          /**< TDO bytes */
+			uint8_t *bit_ptr; /**< last bit destination */
+			uint8_t bit_mask; /**< last bit mask in bit_ptr */
+		} pending_t;
+		std::deque<pending_t> _pending;
 
 		unsigned char *_ll_buffer; /**< message buffer */
 		unsigned char *_buffer;    /**< subset of _ll_buffer */
@@ -328,30 +328,26 @@ void CologneChip::programJTAG_flash(unsigned int offset, uint8_t *data,
  */
 int CologneChip::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	int xfer_len = len + 1;
-	uint8_t jtx[xfer_len+2];
-	uint8_t jrx[xfer_len+2];
+	return spi_put_batch({{cmd, tx, rx, len}});
+}
 
-	jtx[0] = ConfigBitstreamParser::reverseByte(cmd);
+int CologneChip::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	return _jtag->spi_put_batch(xfers,
+		[&](const spi_xfer_t &x, uint8_t *rx) {
+			int xfer_len = x.len + 1;
+			std::vector<uint8_t> jtx(xfer_len+2);
 
-	if (tx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i+1] = ConfigBitstreamParser::reverseByte(tx[i]);
-	}
+			jtx[0] = ConfigBitstreamParser::reverseByte(x.cmd);
 
-	_jtag->shiftIR(JTAG_SPI_BYPASS, 6, Jtag::SELECT_DR_SCAN);
+			if (x.tx != NULL)
+				ConfigBitstreamParser::reverseBytes(x.tx, &jtx[1], x.len);
 
-	int test = (rx == NULL) ? 8*xfer_len+1 : 8*xfer_len+2;
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, test, Jtag::SELECT_DR_SCAN);
+			_jtag->shiftIR(JTAG_SPI_BYPASS, 6, Jtag::SELECT_DR_SCAN);
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++) {
-			uint8_t b0 = ConfigBitstreamParser::reverseByte(jrx[i+1]);
-			uint8_t b1 = ConfigBitstreamParser::reverseByte(jrx[i+2]);
-			rx[i] = (b0 << 1) | ((b1 >> 7) & 0x01);
-		}
-	}
-	return 0;
+			int test = (rx == NULL) ? 8*xfer_len+1 : 8*xfer_len+2;
+			_jtag->shiftDR(jtx.data(), rx, test, Jtag::SELECT_DR_SCAN);
+		});
 }
 
 /**
@@ -363,21 +359,14 @@ int CologneChip::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	uint8_t jtx[xfer_len+2];
 	uint8_t jrx[xfer_len+2];
 
-	if (tx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i] = ConfigBitstreamParser::reverseByte(tx[i]);
-	}
+	if (tx != NULL)
+		ConfigBitstreamParser::reverseBytes(tx, jtx, len);
 
 	_jtag->shiftIR(JTAG_SPI_BYPASS, 6, Jtag::SELECT_DR_SCAN);
 	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len+1, Jtag::SELECT_DR_SCAN);
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++) {
-			uint8_t b0 = ConfigBitstreamParser::reverseByte(jrx[i]);
-			uint8_t b1 = ConfigBitstreamParser::reverseByte(jrx[i+1]);
-			rx[i] = (b0 << 1) | ((b1 >> 7) & 0x01);
-		}
-	}
+	if (rx != NULL)
+		ConfigBitstreamParser::reverseShiftedBytes(jrx, rx, len);
 	return 0;
 }
 
@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include "device.hpp"
 #include "jtag.hpp"
@@ -40,6 +41,9 @@ class CologneChip: public Device, SPIInterface {
 			printError("protect flash not supported"); return false;}
 		virtual bool unprotect_flash() override {
 			printError("unprotect flash not supported"); return false;}
+		void set_flash_mode(bool diff_prog, bool blind_prog) override {
+			SPIInterface::set_flash_mode(diff_prog, blind_prog);
+		}
 		void program(unsigned int offset, bool unprotect_flash) override;
 
 		int idCode() override {return 0;}
@@ -57,6 +61,7 @@ class CologneChip: public Device, SPIInterface {
 		int spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx,
 					uint32_t len) override;
 		int spi_put(uint8_t *tx, uint8_t *rx, uint32_t len) override;
+		int spi_put_batch(const std::vector<spi_xfer_t> &xfers) override;
 		int spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond, uint32_t timeout,
 					 bool verbose=false) override;
 
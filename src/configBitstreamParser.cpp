@@ -3,12 +3,17 @@
  * Copyright (C) 2019 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <string>
 #include <stdint.h>
+#include <string.h>
 #include <strings.h>
 #include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #ifdef HAS_ZLIB
 #ifdef HAS_ZLIBNG
@@ -22,18 +27,31 @@
 #endif
 #endif
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#endif
+
 #include "display.hpp"
 
 #include "configBitstreamParser.hpp"
+#include "flashSource.hpp"
+
+/* STREAM_MODE: Byte decompressed to parse header */
+#define STREAM_PREFIX 0x10000
 
 using namespace std;
 
 ConfigBitstreamParser::ConfigBitstreamParser(const string &filename, int mode,
 			bool verbose): _filename(filename), _bit_length(0),
 			_file_size(0), _verbose(verbose),
-			_bit_data(), _raw_data(), _hdr()
+			_bit_data(), _raw_data(), _hdr(), _raw_ptr(NULL), _raw_len(0),
+			_payload(NULL), _stream_len(0), _stream_reverse(false),
+			_map_addr(NULL), _map_len(0), _stream(NULL), _data_pos(0)
 {
-	(void) mode;
 	if (!filename.empty()) {
 		uint32_t offset =  filename.find_last_of(".");
 
@@ -54,26 +72,71 @@ ConfigBitstreamParser::ConfigBitstreamParser(const string &filename, int mode,
 		_file_size = ftell(_fd);
 		fseek(_fd, 0, SEEK_SET);
 
-		_raw_data.resize(_file_size);
-
-		int ret = fread((char *)&_raw_data[0], sizeof(char), _file_size, _fd);
-		fclose(_fd);
-		if (ret != _file_size)
-			throw std::runtime_error("Error: fail to read " + _filename);
-
+		bool compressed = false;
 		if (offset != string::npos) {
 			string extension = _filename.substr(_filename.find_last_of(".") +1);
-			if (extension == "gz" || extension == "gzip") {
-				string tmp;
-				tmp.reserve(_file_size);
-				if (!decompress_bitstream(_raw_data, &tmp))
-					throw std::runtime_error("Error: decompress failed");
-				_raw_data.clear();
-				_raw_data.append(std::move(tmp));
-				_file_size = _raw_data.size();
+			compressed = (extension == "gz" || extension == "gzip");
+		}
+
+		const bool map_mode = (mode == MMAP_MODE || mode == STREAM_MODE);
+
+		/* compressed file streamed: only the prefix used to parse
+		 * header is decompressed now
+		 */
+		if (mode == STREAM_MODE && compressed) {
+			fclose(_fd);
+			_stream = new FileFlashSource(_filename);
+			_file_size = _stream->size();
+			const int prefix = (_file_size < STREAM_PREFIX) ?
+				_file_size : STREAM_PREFIX;
+			_raw_data.resize(prefix);
+			if (_stream->read((uint8_t *)&_raw_data[0], prefix) != prefix) {
+				delete _stream;
+				throw std::runtime_error("Error: fail to read " + _filename);
 			}
+			_stream_len = _file_size - prefix;
+			_fd = NULL;
+			compressed = false;
 		}
-		_bit_data.reserve(_file_size);
+
+#ifndef _WIN32
+		/* private writable mapping: pages are only copied if
+		 * a consumer modifies data
+		 */
+		if (_fd && map_mode && !compressed && _file_size > 0) {
+			void *addr = mmap(NULL, _file_size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE, fileno(_fd), 0);
+			if (addr != MAP_FAILED) {
+				madvise(addr, _file_size, MADV_SEQUENTIAL);
+				_map_addr = addr;
+				_map_len = _file_size;
+			}
+		}
+#endif
+
+		if (_fd && !_map_addr) {
+			_raw_data.resize(_file_size);
+
+			int ret = fread((char *)&_raw_data[0], sizeof(char), _file_size, _fd);
+			if (ret != _file_size) {
+				fclose(_fd);
+				throw std::runtime_error("Error: fail to read " + _filename);
+			}
+		}
+		if (_fd)
+			fclose(_fd);
+
+		if (compressed) {
+			string tmp;
+			if (!decompress_bitstream(_raw_data, &tmp))
+				throw std::runtime_error("Error: decompress failed");
+			_raw_data.clear();
+			_raw_data.append(std::move(tmp));
+			_file_size = _raw_data.size();
+		}
+		/* mapped content is used in place by parsers */
+		if (!map_mode)
+			_bit_data.reserve(_file_size);
 
 	} else if (!isatty(fileno(stdin))) {
 		_file_size = 0;
@@ -89,10 +152,23 @@ ConfigBitstreamParser::ConfigBitstreamParser(const string &filename, int mode,
 	} else {
 		throw std::runtime_error("Error: fail to parse. No filename or pipe\n");
 	}
+
+	if (_map_addr) {
+		_raw_ptr = (const char *)_map_addr;
+		_raw_len = _map_len;
+	} else {
+		_raw_ptr = _raw_data.data();
+		_raw_len = _raw_data.size();
+	}
 }
 
 ConfigBitstreamParser::~ConfigBitstreamParser()
 {
+	delete _stream;
+#ifndef _WIN32
+	if (_map_addr)
+		munmap(_map_addr, _map_len);
+#endif
 }
 
 string ConfigBitstreamParser::getHeaderVal(string key)
@@ -103,6 +179,33 @@ string ConfigBitstreamParser::getHeaderVal(string key)
 	return val->second;
 }
 
+uint8_t *ConfigBitstreamParser::nextData(int len)
+{
+	/* Byte available in memory */
+	const int mem_len = _bit_length / 8 - _stream_len;
+	if (_data_pos + len <= mem_len) {
+		uint8_t *data = getData() + _data_pos;
+		_data_pos += len;
+		return data;
+	}
+	if (!_stream)
+		return NULL;
+
+	/* end of in memory Byte followed by streamed Byte */
+	_stream_buf.resize(len);
+	int off = 0;
+	if (_data_pos < mem_len) {
+		off = mem_len - _data_pos;
+		memcpy(_stream_buf.data(), getData() + _data_pos, off);
+	}
+	if (_stream->read(&_stream_buf[off], len - off) != len - off)
+		return NULL;
+	if (_stream_reverse)
+		reverseBytes(&_stream_buf[off], &_stream_buf[off], len - off);
+	_data_pos += len;
+	return _stream_buf.data();
+}
+
 void ConfigBitstreamParser::displayHeader()
 {
 	if (_hdr.empty())
@@ -157,7 +260,303 @@ uint8_t ConfigBitstreamParser::reverseByte(uint8_t src)
 #endif
 }
 
-bool ConfigBitstreamParser::decompress_bitstream(string source, string *dest)
+/* bit reversal by nibble: reverse(b) = lo_rev[b & 0x0f] | hi_rev[b >> 4]
+ * each table lookup is done with one shuffle for 16/32 Byte
+ */
+#define REV_LO_NIBBLE 0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, \
+		0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0
+#define REV_HI_NIBBLE 0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e, \
+		0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f
+
+static size_t reverse_bytes_table(const uint8_t *src, uint8_t *dst, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		dst[i] = revertByteArr[src[i]];
+	return len;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("ssse3")))
+static size_t reverse_bytes_ssse3(const uint8_t *src, uint8_t *dst, size_t len)
+{
+	const __m128i lo_rev = _mm_setr_epi8(REV_LO_NIBBLE);
+	const __m128i hi_rev = _mm_setr_epi8(REV_HI_NIBBLE);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+		__m128i lo = _mm_and_si128(v, mask);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		v = _mm_or_si128(_mm_shuffle_epi8(lo_rev, lo),
+			_mm_shuffle_epi8(hi_rev, hi));
+		_mm_storeu_si128((__m128i *)&dst[i], v);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t reverse_bytes_avx2(const uint8_t *src, uint8_t *dst, size_t len)
+{
+	/* shuffle works per 128 bits lane: tables are duplicated */
+	const __m256i lo_rev = _mm256_setr_epi8(REV_LO_NIBBLE, REV_LO_NIBBLE);
+	const __m256i hi_rev = _mm256_setr_epi8(REV_HI_NIBBLE, REV_HI_NIBBLE);
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	size_t i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)&src[i]);
+		__m256i lo = _mm256_and_si256(v, mask);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+		v = _mm256_or_si256(_mm256_shuffle_epi8(lo_rev, lo),
+			_mm256_shuffle_epi8(hi_rev, hi));
+		_mm256_storeu_si256((__m256i *)&dst[i], v);
+	}
+	return i;
+}
+#elif defined(SIMD_NEON)
+static size_t reverse_bytes_neon(const uint8_t *src, uint8_t *dst, size_t len)
+{
+	size_t i = 0;
+#ifdef __aarch64__
+	for (; i + 16 <= len; i += 16)
+		vst1q_u8(&dst[i], vrbitq_u8(vld1q_u8(&src[i])));
+#else
+	static const uint8_t lo_tbl[16] = {REV_LO_NIBBLE};
+	static const uint8_t hi_tbl[16] = {REV_HI_NIBBLE};
+	const uint8x8x2_t lo_rev = {{vld1_u8(lo_tbl), vld1_u8(&lo_tbl[8])}};
+	const uint8x8x2_t hi_rev = {{vld1_u8(hi_tbl), vld1_u8(&hi_tbl[8])}};
+	const uint8x8_t mask = vdup_n_u8(0x0f);
+	for (; i + 8 <= len; i += 8) {
+		uint8x8_t v = vld1_u8(&src[i]);
+		v = vorr_u8(vtbl2_u8(lo_rev, vand_u8(v, mask)),
+			vtbl2_u8(hi_rev, vshr_n_u8(v, 4)));
+		vst1_u8(&dst[i], v);
+	}
+#endif
+	return i;
+}
+#endif
+
+void ConfigBitstreamParser::reverseBytes(const uint8_t *src, uint8_t *dst,
+		size_t len)
+{
+	typedef size_t (*reverse_fn)(const uint8_t *, uint8_t *, size_t);
+#ifdef SIMD_X86
+	/* kernel selected once according to CPU features */
+	static const reverse_fn kernel =
+		__builtin_cpu_supports("avx2") ? reverse_bytes_avx2 :
+		__builtin_cpu_supports("ssse3") ? reverse_bytes_ssse3 :
+		reverse_bytes_table;
+#elif defined(SIMD_NEON)
+	static const reverse_fn kernel = reverse_bytes_neon;
+#else
+	static const reverse_fn kernel = reverse_bytes_table;
+#endif
+	size_t done = kernel(src, dst, len);
+	/* remaining Byte (less than one vector) */
+	reverse_bytes_table(&src[done], &dst[done], len - done);
+}
+
+void ConfigBitstreamParser::reverseShiftedBytes(const uint8_t *src,
+		uint8_t *dst, size_t len)
+{
+	/* realign stream (loop vectorised by compiler) then reverse */
+	for (size_t i = 0; i < len; i++)
+		dst[i] = (src[i] >> 1) | (src[i + 1] << 7);
+	reverseBytes(dst, dst, len);
+}
+
+/* ASCII '0'/'1' packing: one compare gives one Byte per character
+ * (0xff for '1'), movemask (or weighted pairwise add for NEON)
+ * collects them in LSB first order
+ */
+static size_t pack_ascii_bits_scalar(const char *src, size_t len, uint8_t *dst)
+{
+	for (size_t i = 0; i < len; i += 8) {
+		const size_t nb = (len - i < 8) ? len - i : 8;
+		uint8_t val = 0;
+		for (size_t b = 0; b < nb; b++)
+			val |= (src[i + b] == '1') << b;
+		dst[i / 8] = val;
+	}
+	return len;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2")))
+static size_t pack_ascii_bits_sse2(const char *src, size_t len, uint8_t *dst)
+{
+	const __m128i one = _mm_set1_epi8('1');
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+		const uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, one));
+		dst[i / 8] = mask & 0xff;
+		dst[i / 8 + 1] = (mask >> 8) & 0xff;
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t pack_ascii_bits_avx2(const char *src, size_t len, uint8_t *dst)
+{
+	const __m256i one = _mm256_set1_epi8('1');
+	size_t i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)&src[i]);
+		const uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, one));
+		/* x86 is little endian: Byte order matches characters order */
+		memcpy(&dst[i / 8], &mask, 4);
+	}
+	return i;
+}
+#elif defined(SIMD_NEON)
+static size_t pack_ascii_bits_neon(const char *src, size_t len, uint8_t *dst)
+{
+	static const uint8_t weight_tbl[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+		1, 2, 4, 8, 16, 32, 64, 128};
+	const uint8x16_t weight = vld1q_u8(weight_tbl);
+	const uint8x16_t one = vdupq_n_u8('1');
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)&src[i]);
+		v = vandq_u8(vceqq_u8(v, one), weight);
+		/* 3 pairwise adds: lane 0/1 are sums of low/high half */
+		uint8x8_t sum = vpadd_u8(vget_low_u8(v), vget_high_u8(v));
+		sum = vpadd_u8(sum, sum);
+		sum = vpadd_u8(sum, sum);
+		dst[i / 8] = vget_lane_u8(sum, 0);
+		dst[i / 8 + 1] = vget_lane_u8(sum, 1);
+	}
+	return i;
+}
+#endif
+
+void ConfigBitstreamParser::packAsciiBits(const char *src, size_t len,
+		uint8_t *dst)
+{
+	typedef size_t (*pack_fn)(const char *, size_t, uint8_t *);
+#ifdef SIMD_X86
+	/* kernel selected once according to CPU features */
+	static const pack_fn kernel =
+		__builtin_cpu_supports("avx2") ? pack_ascii_bits_avx2 :
+		__builtin_cpu_supports("sse2") ? pack_ascii_bits_sse2 :
+		pack_ascii_bits_scalar;
+#elif defined(SIMD_NEON)
+	static const pack_fn kernel = pack_ascii_bits_neon;
+#else
+	static const pack_fn kernel = pack_ascii_bits_scalar;
+#endif
+	/* kernels process multiple of 16 characters: always Byte aligned */
+	size_t done = kernel(src, len, dst);
+	pack_ascii_bits_scalar(&src[done], len - done, &dst[done / 8]);
+}
+
+/* hexadecimal digit value, -1 for any other character */
+static const struct HexTable {
+	int8_t val[256];
+	HexTable() {
+		for (int i = 0; i < 256; i++)
+			val[i] = -1;
+		for (int i = 0; i < 10; i++)
+			val['0' + i] = i;
+		for (int i = 0; i < 6; i++)
+			val['a' + i] = val['A' + i] = 10 + i;
+	}
+} hex_table;
+
+/* decode len Byte (2 digits each), return false on non hexadecimal
+ * character
+ */
+static inline bool hex_to_bytes(const char *src, uint8_t *dst, int len)
+{
+	int err = 0;
+	for (int i = 0; i < len; i++, src += 2) {
+		const int hi = hex_table.val[(uint8_t)src[0]];
+		const int lo = hex_table.val[(uint8_t)src[1]];
+		err |= hi | lo;
+		dst[i] = (hi << 4) | (lo & 0x0f);
+	}
+	return err >= 0;
+}
+
+/* record format
+ * :LLAAAATTHH...HHCC
+ * LL   : number of data Byte
+ * AAAA : record address
+ * TT   : record type
+ * HH   : data
+ * CC   : checksum: two's complement of the sum of all previous Byte
+ */
+bool ConfigBitstreamParser::decodeHexRecord(const char *line, size_t len,
+		hex_record_t &rec)
+{
+	uint8_t hdr[4], checksum;
+
+	if (len < 11 || line[0] != ':' || !hex_to_bytes(&line[1], hdr, 4))
+		return false;
+	rec.len = hdr[0];
+	rec.addr = (hdr[1] << 8) | hdr[2];
+	rec.type = hdr[3];
+	if (len < 11 + 2 * (size_t)rec.len ||
+			!hex_to_bytes(&line[9], rec.data, rec.len) ||
+			!hex_to_bytes(&line[9 + 2 * rec.len], &checksum, 1))
+		return false;
+
+	uint8_t sum = hdr[0] + hdr[1] + hdr[2] + hdr[3] + checksum;
+	for (int i = 0; i < rec.len; i++)
+		sum += rec.data[i];
+	return sum == 0;
+}
+
+void ConfigBitstreamParser::storeData(uint32_t addr, const uint8_t *data,
+		uint32_t len, bool reverse)
+{
+	if (len == 0)
+		return;
+	if (addr + len > _bit_data.size())
+		_bit_data.resize(addr + len, (char)0xff);
+	uint8_t *dst = (uint8_t *)&_bit_data[addr];
+	if (reverse)
+		reverseBytes(data, dst, len);
+	else
+		memcpy(dst, data, len);
+
+	/* records are usually contiguous: extend last segment */
+	if (!_segments.empty() &&
+			_segments.back().addr + _segments.back().len == addr)
+		_segments.back().len += len;
+	else
+		_segments.push_back({addr, len});
+}
+
+void ConfigBitstreamParser::closeSegments()
+{
+	std::sort(_segments.begin(), _segments.end(),
+		[](const data_segment_t &a, const data_segment_t &b) {
+			return a.addr < b.addr;
+		});
+
+	/* merge overlapping or adjacent segments */
+	size_t nb = 0;
+	for (size_t i = 0; i < _segments.size(); i++) {
+		const data_segment_t &seg = _segments[i];
+		if (nb != 0 && seg.addr <= _segments[nb - 1].addr +
+				_segments[nb - 1].len) {
+			data_segment_t &prev = _segments[nb - 1];
+			const uint32_t end = std::max(prev.addr + prev.len,
+				seg.addr + seg.len);
+			prev.len = end - prev.addr;
+		} else {
+			_segments[nb++] = seg;
+		}
+	}
+	_segments.resize(nb);
+
+	_bit_length = _bit_data.size() * 8;
+}
+
+bool ConfigBitstreamParser::decompress_bitstream(const string &source,
+		string *dest)
 {
 #ifndef HAS_ZLIB
 	(void)source;
@@ -170,9 +569,16 @@ bool ConfigBitstreamParser::decompress_bitstream(string source, string *dest)
 	int ret;
 	unsigned have;
 	z_stream strm;
-	unsigned char *in = (unsigned char *)&source[0];
+	unsigned char *in = (unsigned char *)source.data();
 	unsigned char out[CHUNK];
 
+	/* gzip trailer ends with uncompressed size (modulo 2^32) */
+	if (source.size() >= 18) {
+		const uint8_t *isize = &in[source.size() - 4];
+		dest->reserve(isize[0] | (isize[1] << 8) | (isize[2] << 16) |
+			((uint32_t)isize[3] << 24));
+	}
+
 	/* allocate inflate state */
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
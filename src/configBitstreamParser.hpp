@@ -12,6 +12,9 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
+
+class FlashSource;
 
 class ConfigBitstreamParser {
 	public:
@@ -19,9 +22,37 @@ class ConfigBitstreamParser {
 			bool verbose = false);
 		virtual ~ConfigBitstreamParser();
 		virtual int parse() = 0;
-		uint8_t *getData() {return (uint8_t*)_bit_data.c_str();}
+		uint8_t *getData() {
+			return (_payload) ? _payload : (uint8_t*)_bit_data.c_str();
+		}
 		int getLength() {return _bit_length;}
 
+		/*!
+		 * \brief populated area of getData(): offset and length
+		 *        (in Byte)
+		 */
+		typedef struct {
+			uint32_t addr;
+			uint32_t len;
+		} data_segment_t;
+		/*!
+		 * \brief return populated areas of getData(), sorted by address
+		 *        and without overlap. Bytes between two segments are
+		 *        not part of the file (0xff filled).
+		 *        Empty when getData() is fully populated
+		 */
+		const std::vector<data_segment_t> &getSegments() const {
+			return _segments;
+		}
+		/*!
+		 * \brief return next len Byte of parsed data (starting with
+		 *        first Byte). In STREAM_MODE data not yet decompressed
+		 *        are read from the file
+		 * \param[in] len: number of Byte
+		 * \return pointer valid until next call, NULL if read fails
+		 */
+		uint8_t *nextData(int len);
+
 		/**
 		 * \brief display header informations
 		 */
@@ -42,10 +73,48 @@ class ConfigBitstreamParser {
 
 		enum {
 			ASCII_MODE = 0,
-			BIN_MODE = std::ifstream::binary
+			BIN_MODE = std::ifstream::binary,
+			/* binary file mapped in memory: content is not copied
+			 * (fallback to BIN_MODE when file can't be mapped)
+			 */
+			MMAP_MODE = 0x10000,
+			/* as MMAP_MODE but gzip files are only decompressed up to
+			 * STREAM_PREFIX Byte by constructor. Remaining data are
+			 * decompressed (by a worker thread) when consumed with
+			 * nextData(): getData() only contains the prefix
+			 */
+			STREAM_MODE = 0x20000
 		};
 
 		static uint8_t reverseByte(uint8_t src);
+		/*!
+		 * \brief reverse bits order of each Byte (LSB <-> MSB):
+		 *        vectorised (AVX2/SSSE3 selected at runtime, NEON)
+		 *        with a table fallback
+		 * \param[in] src: Byte to reverse
+		 * \param[out] dst: reversed Byte (may be src)
+		 * \param[in] len: number of Byte
+		 */
+		static void reverseBytes(const uint8_t *src, uint8_t *dst, size_t len);
+		/*!
+		 * \brief reverse bits order of a stream received one bit late:
+		 *        dst[i] = reverseByte((src[i] >> 1) | (src[i + 1] << 7))
+		 * \param[in] src: received Byte (len + 1 Byte are read)
+		 * \param[out] dst: reversed Byte (must not overlap src)
+		 * \param[in] len: number of Byte to produce
+		 */
+		static void reverseShiftedBytes(const uint8_t *src, uint8_t *dst,
+			size_t len);
+		/*!
+		 * \brief pack ASCII '0'/'1' characters: character i is bit
+		 *        (i % 8) of dst[i / 8] (LSB first), any character other
+		 *        than '1' is a 0 and last Byte is padded with 0.
+		 *        Vectorised (AVX2/SSE2 selected at runtime, NEON)
+		 * \param[in] src: characters
+		 * \param[in] len: number of characters
+		 * \param[out] dst: packed bits ((len + 7) / 8 Byte)
+		 */
+		static void packAsciiBits(const char *src, size_t len, uint8_t *dst);
 
 	private:
 		/**
@@ -55,9 +124,43 @@ class ConfigBitstreamParser {
 		 * \return false if openFPGALoader is build without zlib or
 		 *              if uncompress fails
 		 */
-		bool decompress_bitstream(std::string source, std::string *dest);
+		bool decompress_bitstream(const std::string &source, std::string *dest);
 
 	protected:
+		/*!
+		 * \brief Intel HEX record (:LLAAAATTHH...HHCC)
+		 */
+		typedef struct {
+			uint8_t len;        /**< number of data Byte */
+			uint16_t addr;      /**< record address */
+			uint8_t type;       /**< record type */
+			uint8_t data[255];  /**< decoded data */
+		} hex_record_t;
+		/*!
+		 * \brief decode one Intel HEX record (no sscanf: lookup table)
+		 * \param[in] line: record, starting with ':'
+		 * \param[in] len: line length (end of line excluded)
+		 * \param[out] rec: decoded record
+		 * \return false if line is malformed or checksum is wrong
+		 */
+		static bool decodeHexRecord(const char *line, size_t len,
+			hex_record_t &rec);
+		/*!
+		 * \brief copy len Byte at addr in _bit_data (grown and 0xff
+		 *        filled as needed) and add area to segments list
+		 * \param[in] addr: offset in _bit_data
+		 * \param[in] data: Byte to store
+		 * \param[in] len: number of Byte
+		 * \param[in] reverse: reverse bits order of each Byte
+		 */
+		void storeData(uint32_t addr, const uint8_t *data, uint32_t len,
+			bool reverse);
+		/*!
+		 * \brief sort and merge segments filled by storeData,
+		 *        update _bit_length to cover last segment
+		 */
+		void closeSegments();
+
 		std::string _filename;
 		int _bit_length;
 		int _file_size;
@@ -65,6 +168,20 @@ class ConfigBitstreamParser {
 		std::string _bit_data;
 		std::string _raw_data; /**< unprocessed file content */
 		std::map<std::string, std::string> _hdr;
+		const char *_raw_ptr; /**< file content: mapped file or _raw_data */
+		size_t _raw_len;      /**< file content length */
+		uint8_t *_payload;    /**< parsed data when it's a view into file
+		                       *   content (NULL: _bit_data is used) */
+		int _stream_len;      /**< STREAM_MODE: Byte not yet decompressed */
+		bool _stream_reverse; /**< STREAM_MODE: reverse streamed Byte */
+		std::vector<data_segment_t> _segments; /**< populated areas */
+
+	private:
+		void *_map_addr;      /**< mapped file (NULL: not mapped) */
+		size_t _map_len;      /**< mapped length */
+		FlashSource *_stream; /**< STREAM_MODE: decompressed file reader */
+		int _data_pos;        /**< nextData position */
+		std::vector<uint8_t> _stream_buf; /**< nextData streamed buffer */
 };
 
 #endif
@@ -48,6 +48,11 @@ class Device {
 			printError("dump flash not supported"); return false;}
 		virtual bool protect_flash(uint32_t len) = 0;
 		virtual bool unprotect_flash() = 0;
+		/*!
+		 * \brief select SPI flash write strategy (see SPIInterface)
+		 */
+		virtual void set_flash_mode(bool diff_prog, bool blind_prog) {
+			(void)diff_prog; (void)blind_prog;}
 
 		virtual int  idCode() = 0;
 		virtual void reset();
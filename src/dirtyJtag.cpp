@@ -61,7 +61,7 @@ enum dirtyJtagSig {
 
 DirtyJtag::DirtyJtag(uint32_t clkHZ, uint8_t verbose):
 			_verbose(verbose),
-			dev_handle(NULL), usb_ctx(NULL), _tdi(0), _tms(0)
+			dev_handle(NULL), usb_ctx(NULL), _usb(NULL), _tdi(0), _tms(0)
 {
 	int ret;
 
@@ -86,6 +86,9 @@ DirtyJtag::DirtyJtag(uint32_t clkHZ, uint8_t verbose):
 		throw std::exception();
 	}
 
+	_usb = new UsbBulkEngine(usb_ctx, dev_handle, DIRTYJTAG_WRITE_EP,
+		DIRTYJTAG_READ_EP, 512);
+
 	_version = 0;
 	getVersion();
 
@@ -97,6 +100,8 @@ DirtyJtag::DirtyJtag(uint32_t clkHZ, uint8_t verbose):
 
 DirtyJtag::~DirtyJtag()
 {
+	if (_usb)
+		delete _usb;
 	if (dev_handle)
 		libusb_close(dev_handle);
 	if (usb_ctx)
@@ -140,7 +145,6 @@ void DirtyJtag::getVersion()
 
 int DirtyJtag::setClkFreq(uint32_t clkHZ)
 {
-	int actual_length;
 	int ret, req_freq = clkHZ;
 
 	if (clkHZ > 16000000) {
@@ -157,8 +161,7 @@ int DirtyJtag::setClkFreq(uint32_t clkHZ)
 					static_cast<uint8_t>(0xff & ((clkHZ / 1000) >> 8)),
 					static_cast<uint8_t>(0xff & ((clkHZ / 1000)     )),
 					CMD_STOP};
-	ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
-			        buf, 4, &actual_length, 1000);
+	ret = _usb->write(buf, 4);
 	if (ret < 0) {
 		cerr << "setClkFreq: usb bulk write failed " << ret << endl;
 		return -EXIT_FAILURE;
@@ -170,7 +173,6 @@ int DirtyJtag::setClkFreq(uint32_t clkHZ)
 int DirtyJtag::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 {
 	(void) flush_buffer;
-	int actual_length;
 
 	if (len == 0)
 		return 0;
@@ -196,8 +198,7 @@ int DirtyJtag::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 				buf[buffer_idx++] = val;
 			}
 			buf[buffer_idx++] = CMD_STOP;
-			int ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
-										   buf, buffer_idx, &actual_length, 1000);
+			int ret = _usb->write(buf, buffer_idx);
 			if (ret < 0)
 			{
 				cerr << "writeTMS: usb bulk write failed " << ret << endl;
@@ -211,7 +212,6 @@ int DirtyJtag::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 
 int DirtyJtag::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 {
-	int actual_length;
 	uint8_t buf[] = {CMD_CLK,
 				static_cast<uint8_t>(((tms) ? SIG_TMS : 0) | ((tdi) ? SIG_TDI : 0)),
 				0,
@@ -219,8 +219,7 @@ int DirtyJtag::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	while (clk_len > 0) {
 		buf[2] = (clk_len > 64) ? 64 : (uint8_t)clk_len;
 
-		int ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
-				buf, 4, &actual_length, 1000);
+		int ret = _usb->write(buf, 4);
 		if (ret < 0) {
 			cerr << "toggleClk: usb bulk write failed " << ret << endl;
 			return -EXIT_FAILURE;
@@ -233,17 +232,16 @@ int DirtyJtag::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 
 int DirtyJtag::flush()
 {
-	return 0;
+	return _usb->flush();
 }
 
 int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 {
-	int actual_length;
 	uint32_t real_bit_len = len - (end ? 1 : 0);
 	uint32_t real_byte_len = (len + 7) / 8;
 
 	uint8_t tx_cpy[real_byte_len];
-	uint8_t tx_buf[512], rx_buf[512];
+	uint8_t tx_buf[512];
 	uint8_t *tx_ptr, *rx_ptr = rx;
 
 	if (tx)
@@ -279,36 +277,36 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			if (tx_ptr[i >> 3] & (1 << (i & 0x07)))
 				tx_buf[header_offset + (i >> 3)] |= (0x80 >> (i & 0x07));
 
-		actual_length = 0;
-		int ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
-		        (unsigned char *)tx_buf, (byte_to_send + header_offset),
-				&actual_length, 1000);
-		if ((ret < 0) || (actual_length != (int)(byte_to_send + header_offset))) {
-			cerr << "writeTDI: fill: usb bulk write failed " << ret <<
-				"actual length: " << actual_length << endl;
+		/* transfers are only queued: next packet is built while
+		 * this one is sent. rx is filled by the read completion
+		 */
+		int ret = _usb->write(tx_buf, byte_to_send + header_offset);
+		if (ret < 0) {
+			cerr << "writeTDI: fill: usb bulk write failed " << ret << endl;
 			return EXIT_FAILURE;
 		}
-		// cerr << actual_length << ", " << bit_to_send << endl;
 
 		if (rx || (_version <= 1)) {
 			int transfer_length = (bit_to_send > 255) ? byte_to_send :32;
-			do {
-				ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
-					rx_buf, transfer_length, &actual_length, 1000);
-				if (ret < 0) {
-					cerr << "writeTDI: read: usb bulk read failed " << ret << endl;
-					return EXIT_FAILURE;
-				}
-			} while (actual_length == 0);
-			assert((size_t)actual_length >= byte_to_send);
+			uint8_t *dst = (rx) ? rx_ptr : NULL;
+			ret = _usb->read(transfer_length,
+				[dst, bit_to_send, byte_to_send](const uint8_t *rx_buf, int rx_len) {
+					assert((size_t)rx_len >= byte_to_send);
+					if (!dst)
+						return true;
+					for (int i = 0; i < bit_to_send; i++)
+						dst[i >> 3] = (dst[i >> 3] >> 1) |
+							(((rx_buf[i >> 3] << (i&0x07)) & 0x80));
+					return true;
+				});
+			if (ret < 0) {
+				cerr << "writeTDI: read: usb bulk read failed " << ret << endl;
+				return EXIT_FAILURE;
+			}
 		}
 
-		if (rx) {
-			for (int i = 0; i < bit_to_send; i++)
-				rx_ptr[i >> 3] = (rx_ptr[i >> 3] >> 1) |
-						(((rx_buf[i >> 3] << (i&0x07)) & 0x80));
+		if (rx)
 			rx_ptr += byte_to_send;
-		}
 
 		real_bit_len -= bit_to_send;
 		tx_ptr += byte_to_send;
@@ -317,7 +315,6 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 	/* this step exist only with [D|I]R_SHIFT */
 	if (end) {
 		int pos = len-1;
-		uint8_t sig;
 		unsigned char last_bit =
 				(tx_cpy[pos >> 3] & (1 << (pos & 0x07))) ? SIG_TDI: 0;
 
@@ -337,30 +334,25 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 				CMD_GETSIG,  // <---Read instruction
 				CMD_STOP,
 			};
-			if (libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
-									 buf, sizeof(buf), &actual_length, 1000) < 0)
+			if (_usb->write(buf, sizeof(buf)) < 0)
 			{
 				cerr << "writeTDI: last bit error: usb bulk write failed 1" << endl;
 				return -EXIT_FAILURE;
 			}
-			do
-			{
-				if (libusb_bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
-											&sig, 1, &actual_length, 1000) < 0)
-				{
-					cerr << "writeTDI: last bit error: usb bulk read failed" << endl;
-					return -EXIT_FAILURE;
-				}
-			} while (actual_length == 0);
-			rx[pos >> 3] >>= 1;
-			if (sig & SIG_TDO)
+			if (_usb->read(1, [rx, pos](const uint8_t *sig, int sig_len) {
+						(void)sig_len;
+						rx[pos >> 3] >>= 1;
+						if (sig[0] & SIG_TDO)
+							rx[pos >> 3] |= (1 << (pos & 0x07));
+						return true;
+					}) < 0)
 			{
-				rx[pos >> 3] |= (1 << (pos & 0x07));
+				cerr << "writeTDI: last bit error: usb bulk read failed" << endl;
+				return -EXIT_FAILURE;
 			}
 			buf[2] &= ~SIG_TCK;
 			buf[3] = CMD_STOP;
-			if (libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
-									 buf, 4, &actual_length, 1000) < 0)
+			if (_usb->write(buf, 4) < 0)
 			{
 				cerr << "writeTDI: last bit error: usb bulk write failed 2" << endl;
 				return -EXIT_FAILURE;
@@ -373,5 +365,11 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			}
 		}
 	}
+
+	/* rx must be filled before return */
+	if (rx && _usb->flush() < 0) {
+		cerr << "writeTDI: usb bulk transfer failed" << endl;
+		return EXIT_FAILURE;
+	}
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+
+#ifdef HAS_ZLIB
+#ifdef HAS_ZLIBNG
+#include <zlib-ng.h>
+#define gzopen(_path, _mode)       zng_gzopen(_path, _mode)
+#define gzread(_file, _buf, _len)  zng_gzread(_file, _buf, _len)
+#define gzclose(_file)             zng_gzclose(_file)
+#else
+#include <zlib.h>
+#endif
+#endif
+
+#include "flashSource.hpp"
+
+/* inflate ring: memory used is INFLATE_RING_SIZE x INFLATE_CHUNK */
+#define INFLATE_RING_SIZE  4
+#define INFLATE_CHUNK      0x40000
+
+FileFlashSource::FileFlashSource(const std::string &filename):
+		_filename(filename), _compressed(false), _size(0), _pos(0),
+		_fd(NULL), _gzfd(NULL), _rd_slot(0), _rd_off(0), _wr_slot(0),
+		_filled(0), _stop(false)
+{
+	FILE *fd = fopen(_filename.c_str(), "rb");
+	size_t offset = _filename.find_last_of(".");
+	/* if file not found it's maybe a gz -> try without gz */
+	if (!fd && offset != std::string::npos) {
+		_filename = _filename.substr(0, offset);
+		fd = fopen(_filename.c_str(), "rb");
+	}
+	if (!fd)
+		throw std::runtime_error("Error: fail to open " + filename);
+
+	fseek(fd, 0, SEEK_END);
+	long file_size = ftell(fd);
+
+	offset = _filename.find_last_of(".");
+	if (offset != std::string::npos) {
+		std::string extension = _filename.substr(offset + 1);
+		_compressed = (extension == "gz" || extension == "gzip");
+	}
+
+	if (_compressed) {
+		/* gzip trailer ends with uncompressed size modulo 2^32
+		 * (little endian)
+		 */
+		uint8_t isize[4];
+		if (file_size < 18 || fseek(fd, -4, SEEK_END) != 0 ||
+				fread(isize, 1, 4, fd) != 4) {
+			fclose(fd);
+			throw std::runtime_error("Error: " + _filename +
+				" is not a gzip file");
+		}
+		_size = isize[0] | (isize[1] << 8) | (isize[2] << 16) |
+			((uint32_t)isize[3] << 24);
+	} else {
+		_size = file_size;
+	}
+	fclose(fd);
+
+	if (_size < 0)
+		throw std::runtime_error("Error: " + _filename + " is too large");
+
+	if (!open())
+		throw std::runtime_error("Error: fail to open " + _filename);
+}
+
+FileFlashSource::~FileFlashSource()
+{
+	close();
+}
+
+bool FileFlashSource::open()
+{
+	_pos = 0;
+	if (!_compressed) {
+		_fd = fopen(_filename.c_str(), "rb");
+		return _fd != NULL;
+	}
+#ifdef HAS_ZLIB
+	_gzfd = gzopen(_filename.c_str(), "rb");
+	if (!_gzfd)
+		return false;
+	if (_ring.empty()) {
+		_ring.resize(INFLATE_RING_SIZE);
+		for (auto &chunk : _ring)
+			chunk.resize(INFLATE_CHUNK);
+		_ring_len.resize(INFLATE_RING_SIZE);
+	}
+	_rd_slot = _rd_off = _wr_slot = _filled = 0;
+	_stop = false;
+	_worker = std::thread(&FileFlashSource::inflate_worker, this);
+	return true;
+#else
+	throw std::runtime_error("openFPGALoader is build without zlib support: "
+		"can't uncompress " + _filename);
+#endif
+}
+
+void FileFlashSource::close()
+{
+	if (_fd) {
+		fclose(_fd);
+		_fd = NULL;
+	}
+#ifdef HAS_ZLIB
+	if (_gzfd) {
+		{
+			std::lock_guard<std::mutex> lk(_mtx);
+			_stop = true;
+		}
+		_cv.notify_all();
+		if (_worker.joinable())
+			_worker.join();
+		gzclose((gzFile)_gzfd);
+		_gzfd = NULL;
+	}
+#endif
+}
+
+bool FileFlashSource::rewind()
+{
+	close();
+	return open();
+}
+
+void FileFlashSource::inflate_worker()
+{
+#ifdef HAS_ZLIB
+	std::unique_lock<std::mutex> lk(_mtx);
+	while (true) {
+		_cv.wait(lk, [this]{ return _stop || _filled < INFLATE_RING_SIZE; });
+		if (_stop)
+			return;
+		const int slot = _wr_slot;
+		/* slot is not owned by consumer: inflate without lock */
+		lk.unlock();
+		int ret = gzread((gzFile)_gzfd, _ring[slot].data(), INFLATE_CHUNK);
+		lk.lock();
+		_ring_len[slot] = (ret < 0) ? -1 : ret;
+		_wr_slot = (slot + 1) % INFLATE_RING_SIZE;
+		_filled++;
+		_cv.notify_all();
+		/* end of file or error: consumer stops on this chunk */
+		if (ret <= 0)
+			return;
+	}
+#endif
+}
+
+int FileFlashSource::read(uint8_t *data, int len)
+{
+	if (len > _size - _pos)
+		len = _size - _pos;
+	if (len <= 0)
+		return 0;
+
+	if (_fd) {
+		int ret = fread(data, 1, len, _fd);
+		if (ret != len && ferror(_fd))
+			return -1;
+		_pos += ret;
+		return ret;
+	}
+	if (!_gzfd)
+		return -1;
+
+	int done = 0;
+	std::unique_lock<std::mutex> lk(_mtx);
+	while (done < len) {
+		_cv.wait(lk, [this]{ return _filled > 0; });
+		const int slot = _rd_slot;
+		const int avail = _ring_len[slot];
+		if (avail < 0)
+			return -1;
+		if (avail == 0)  // end of file
+			break;
+		/* chunk is owned by consumer until _filled is decremented */
+		lk.unlock();
+		int size = avail - _rd_off;
+		if (size > len - done)
+			size = len - done;
+		memcpy(data + done, &_ring[slot][_rd_off], size);
+		done += size;
+		_rd_off += size;
+		lk.lock();
+		if (_rd_off == avail) {
+			_rd_off = 0;
+			_rd_slot = (slot + 1) % INFLATE_RING_SIZE;
+			_filled--;
+			_cv.notify_all();
+		}
+	}
+	_pos += done;
+	return done;
+}
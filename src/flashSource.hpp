@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef SRC_FLASHSOURCE_HPP_
+#define SRC_FLASHSOURCE_HPP_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * \file flashSource.hpp
+ * \class FlashSource
+ * \brief sequential data source used to program a flash without
+ *        loading the whole image in memory
+ * \author agent
+ */
+class FlashSource {
+	public:
+		virtual ~FlashSource() {}
+		/*!
+		 * \brief read next len Byte
+		 * \param[out] data: buffer to fill
+		 * \param[in] len: number of Byte to read
+		 * \return number of Byte read (< len at end of data), -1 on error
+		 */
+		virtual int read(uint8_t *data, int len) = 0;
+		/*!
+		 * \brief total data length (in Byte)
+		 */
+		virtual int size() const = 0;
+		/*!
+		 * \brief restart from the first Byte
+		 * \return false if source can't be read again
+		 */
+		virtual bool rewind() = 0;
+};
+
+/*!
+ * \class FileFlashSource
+ * \brief raw/bin file source, gzip compressed files (.gz extension)
+ *        are decompressed on the fly by a worker thread into a bounded
+ *        ring of chunks, so inflate runs while consumer sends data
+ */
+class FileFlashSource: public FlashSource {
+	public:
+		/*!
+		 * \brief open filename. As for ConfigBitstreamParser when file
+		 *        doesn't exist, its name without last extension is tried
+		 * \param[in] filename: file to read
+		 */
+		explicit FileFlashSource(const std::string &filename);
+		~FileFlashSource();
+
+		int read(uint8_t *data, int len) override;
+		int size() const override { return _size; }
+		bool rewind() override;
+
+	private:
+		/*!
+		 * \brief open _filename (raw or compressed)
+		 * \return false if file can't be opened
+		 */
+		bool open();
+		void close();
+		/*!
+		 * \brief worker thread: fill ring with decompressed chunks
+		 *        until end of file, error or close
+		 */
+		void inflate_worker();
+
+		std::string _filename;
+		bool _compressed;
+		int _size;    /*!< uncompressed size */
+		int _pos;     /*!< number of Byte already read */
+		FILE *_fd;    /*!< raw file descriptor */
+		void *_gzfd;  /*!< compressed file descriptor (gzFile) */
+
+		/* inflate ring: _filled chunks are ready starting at _rd_slot */
+		std::vector<std::vector<uint8_t>> _ring;
+		std::vector<int> _ring_len; /*!< chunk length (0: end, -1: error) */
+		int _rd_slot;  /*!< chunk consumed by read */
+		int _rd_off;   /*!< offset in current chunk */
+		int _wr_slot;  /*!< chunk filled by worker */
+		int _filled;   /*!< number of chunks ready */
+		bool _stop;    /*!< request worker to stop */
+		std::mutex _mtx;
+		std::condition_variable _cv;
+		std::thread _worker;
+};
+
+#endif  // SRC_FLASHSOURCE_HPP_
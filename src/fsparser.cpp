@@ -4,7 +4,6 @@
  */
 
 #include <iostream>
-#include <sstream>
 #include <vector>
 #include <cstdio>
 
@@ -39,26 +38,31 @@ int FsParser::parseHeader()
 	string buffer;
 	int line_index = 0;
 	bool in_header = true;
-
-	istringstream lineStream(_raw_data);
-
-	while (std::getline(lineStream, buffer, '\n')) {
-		ret += buffer.size() + 1;
-		if (buffer.empty())
+	size_t pos = 0;
+
+	while (pos < _raw_data.size()) {
+		size_t end = _raw_data.find('\n', pos);
+		if (end == string::npos)
+			end = _raw_data.size();
+		fs_line_t line = {pos, end - pos};
+		ret += line.len + 1;
+		pos = end + 1;
+		if (line.len == 0)
 			break;
 		/* drop all comment, base analyze on header */
-		if (buffer[0] == '/')
+		if (_raw_data[line.offset] == '/')
 			continue;
-		if (buffer[buffer.size()-1] == '\r')
-			buffer.pop_back();
+		if (_raw_data[line.offset + line.len - 1] == '\r')
+			line.len--;
 
-		/* store each line in dedicated buffer for futur use
+		/* store each line position for futur use (no copy)
 		 */
-		_lstRawData.push_back(buffer);
+		_lines.push_back(line);
 
 		if (!in_header)
 			continue;
 
+		buffer = _raw_data.substr(line.offset, line.len);
 		uint8_t c = bitToVal(buffer.substr(0, 8).c_str(), 8);
 		uint8_t key = c & 0x7F;
 		uint64_t val = bitToVal(buffer.c_str(), buffer.size());
@@ -122,7 +126,6 @@ int FsParser::parseHeader()
 
 int FsParser::parse()
 {
-	string tmp;
 	/* GW1N-6 and GW1N(R)-9 are address length not multiple of byte */
 	int padding = 0;
 
@@ -133,14 +136,22 @@ int FsParser::parse()
 	/* Fs file format is MSB first
 	 * so if reverseByte = false bit 0 -> 7, 1 -> 6,
 	 * if true 0 -> 0, 1 -> 1
+	 * lines are packed LSB first in one buffer and reversed
+	 * when MSB first is required
 	 */
-
-	for (auto &&line : _lstRawData) {
-		for (size_t i = 0; i < line.size(); i+=8) {
-			uint8_t data = bitToVal(&line[i], 8);
-			_bit_data += (_reverseByte) ? reverseByte(data) : data;
-		}
+	std::vector<size_t> line_pos(_lines.size());
+	size_t data_len = 0;
+	for (size_t i = 0; i < _lines.size(); i++) {
+		line_pos[i] = data_len;
+		data_len += (_lines[i].len + 7) / 8;
 	}
+	_bit_data.resize(data_len);
+	uint8_t *bit_data = (uint8_t *)&_bit_data[0];
+	for (size_t i = 0; i < _lines.size(); i++)
+		packAsciiBits(&_raw_data[_lines[i].offset], _lines[i].len,
+			&bit_data[line_pos[i]]);
+	if (!_reverseByte)
+		reverseBytes(bit_data, bit_data, data_len);
 
 	_bit_length = static_cast<int>(_bit_data.size() * 8);
 
@@ -191,9 +202,13 @@ int FsParser::parse()
 	if (stoul(_hdr["ConfDataLength"]) < nb_line)
 		nb_line = stoi(_hdr["ConfDataLength"]);
 
-	/* drop now useless header */
-	_lstRawData.erase(_lstRawData.begin(), _lstRawData.begin() + _end_header + 1);
-	_lstRawData.resize(nb_line);
+	/* keep only data lines: number of lines may be smaller than
+	 * nb_line when file is truncated
+	 */
+	const size_t first_line = _end_header + 1;
+	size_t last_line = first_line + nb_line;
+	if (last_line > _lines.size())
+		last_line = _lines.size();
 
 	/* line full length depends on
 	 * 1/ model
@@ -206,38 +221,64 @@ int FsParser::parse()
 	/* to compute checksum two situation
 	 * 1/ uncompressed bitstream -> go
 	 * 2/ compressed bitstream -> need to uncompress this before
+	 * checksum is the sum of 16 bits words (MSB first) of the data
+	 * lines concatenation (without padding and drop bits)
 	 */
 	int drop = 6 * 8;
 	if (_hdr["CRCCheck"] == "ON")
 		drop += 2 * 8;
-	for (auto &&ll = _lstRawData.begin();
-			ll != _lstRawData.end(); ll++) {
-		string l = "";
-		string line = *ll;
-		if (_compressed) {
-			for (size_t i = 0; i < line.size()-drop; i+=8) {
-				uint8_t c = bitToVal((const char *)&line[i], 8);
+
+	_checksum = 0;
+	uint32_t acc = 0;  // bits not yet summed
+	int acc_len = 0;   // number of bits in acc
+	int skip = 0;      // padding bits to drop at start of line
+	/* append nb MSB of c to the stream */
+	auto push = [&](uint8_t c, int nb) {
+		if (skip >= nb) {
+			skip -= nb;
+			return;
+		}
+		if (skip) {
+			c <<= skip;
+			nb -= skip;
+			skip = 0;
+		}
+		acc = (acc << nb) | (c >> (8 - nb));
+		acc_len += nb;
+		if (acc_len >= 16) {
+			acc_len -= 16;
+			_checksum += (acc >> acc_len) & 0xffff;
+		}
+	};
+
+	for (size_t l = first_line; l < last_line; l++) {
+		const uint8_t *line = &bit_data[line_pos[l]];
+		const int line_len = static_cast<int>(_lines[l].len) - drop;
+		skip = padding;
+		for (int i = 0; i < line_len; i += 8) {
+			uint8_t c = line[i / 8];
+			if (_reverseByte)
+				c = reverseByte(c);
+			if (_compressed) {
+				int nb_zero = 0;
 				if (c == _8Zero)
-					l += string(8*8, '0');
+					nb_zero = 8;
 				else if (c == _4Zero)
-					l += string(4*8, '0');
+					nb_zero = 4;
 				else if (c == _2Zero)
-					l += string(2*8, '0');
+					nb_zero = 2;
 				else
-					l += line.substr(i, 8);
+					push(c, 8);
+				for (int z = 0; z < nb_zero; z++)
+					push(0, 8);
+			} else {
+				push(c, (line_len - i < 8) ? line_len - i : 8);
 			}
-		} else {
-			l = line.substr(0, line.size() - drop);
 		}
-
-		/* store bit for checksum */
-		tmp += l.substr(padding, l.size() - padding);
 	}
-
-	/* checksum */
-	_checksum = 0;
-	for (uint32_t pos = 0; pos < tmp.size(); pos+=16)
-		_checksum += (uint16_t)bitToVal(&tmp[pos], 16);
+	/* last word padded with 0 */
+	if (acc_len)
+		_checksum += (acc << (16 - acc_len)) & 0xffff;
 
 	if (_verbose)
 		printf("checksum 0x%04x\n", _checksum);
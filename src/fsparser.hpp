@@ -41,7 +41,12 @@ class FsParser: public ConfigBitstreamParser {
 		uint8_t _2Zero; /*!< in compress mode, used to replace 8 * 0x00 */
 		uint32_t _idcode; /*!< device idcode */
 		bool _compressed; /*!< compress mode or not */
-		std::vector<std::string> _lstRawData; /* cfg + EBR data buffer */
+		/* non comment line position in _raw_data */
+		typedef struct {
+			size_t offset;
+			size_t len;
+		} fs_line_t;
+		std::vector<fs_line_t> _lines; /* header + cfg + EBR data lines */
 };
 
 #endif  // FSPARSER_HPP_
@@ -49,7 +49,7 @@ FtdiJtagBitBang::FtdiJtagBitBang(const FTDIpp_MPSSE::mpsse_bit_config &cable,
 	else if (_pid == 0x6015)  // FT231X
 		_rx_size = 512;
 	else
-		_rx_size = _buffer_size;
+		_rx_size = _ftdi->max_packet_size;
 
 	/* RX Fifo size (rx: USB -> FTDI)
 	 * is 128 or 256 Byte and MaxPacketSize ~= 64Byte
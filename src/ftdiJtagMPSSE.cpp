@@ -12,6 +12,7 @@
 #include <vector>
 #include <string>
 
+#include "display.hpp"
 #include "ftdiJtagMPSSE.hpp"
 #include "ftdipp_mpsse.hpp"
 
@@ -31,6 +32,7 @@ using namespace std;
 FtdiJtagMPSSE::FtdiJtagMPSSE(const FTDIpp_MPSSE::mpsse_bit_config &cable,
 			string dev, const string &serial, uint32_t clkHZ, int8_t verbose):
 			FTDIpp_MPSSE(cable, dev, serial, clkHZ, verbose), _ch552WA(false),
+			_deferred_read(false), _tms_cmd_pos(-1), _tms_cmd_gen(0),
 			_write_mode(0), _read_mode(0)
 {
 	init_internal(cable);
@@ -72,7 +74,12 @@ void FtdiJtagMPSSE::init_internal(const FTDIpp_MPSSE::mpsse_bit_config &cable)
 	display("%x\n", cable.bit_high_val);
 	display("%x\n", cable.bit_high_dir);
 
+	/* CH552 WA: reads back after each packet */
+	if (_ch552WA)
+		_buffer_size = _ftdi->max_packet_size;
+
 	init(5, 0xfb, BITMODE_MPSSE);
+	_async_write = !_ch552WA;
 	config_edge();
 }
 
@@ -103,33 +110,62 @@ void FtdiJtagMPSSE::config_edge()
 	}
 }
 
+/* extract len (<= 7) bits, starting at bit offset, from a LSB first
+ * buffer. MPSSE TMS data is LSB first too: bits are used as is
+ */
+static inline uint8_t tms_bits(const uint8_t *tms, uint32_t offset,
+		uint8_t len)
+{
+	const uint8_t *ptr = tms + (offset >> 3);
+	uint8_t shift = offset & 0x07;
+	uint16_t win = ptr[0];
+	if (shift + len > 8)
+		win |= ptr[1] << 8;
+	return (win >> shift) & ((1 << len) - 1);
+}
+
 int FtdiJtagMPSSE::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 {
-	(void) flush_buffer;
 	display("%s %d %d\n", __func__, len, (len/8)+1);
 
 	if (len == 0)
 		return 0;
 
-	int xfer = len;
+	uint32_t offset = 0;
 	int iter = _buffer_size / 3;
-	int offset = 0, pos = 0;
+	int pos = 0;
+
+	/* previous command is a TMS only command still at the end of the
+	 * buffer: complete it (up to 7 bits) instead of adding a new one
+	 */
+	if (!_ch552WA && _tms_cmd_pos >= 0 && _tms_cmd_gen == _write_count &&
+			_tms_cmd_pos + 3 == _num) {
+		uint8_t *cmd = _buffer + _tms_cmd_pos;
+		uint8_t used = cmd[1] + 1;
+		uint8_t bit_to_send = (len > 7U - used) ? 7 - used : len;
+		if (bit_to_send != 0) {
+			cmd[1] += bit_to_send;
+			cmd[2] |= tms_bits(tms, 0, bit_to_send) << used;
+			offset = bit_to_send;
+		}
+	}
 
 	uint8_t buf[3]= {static_cast<unsigned char>(MPSSE_WRITE_TMS | MPSSE_LSB |
 						MPSSE_BITMODE | _write_mode),
 						0, 0};
-	while (xfer > 0) {
-		int bit_to_send = (xfer > 6) ? 6 : xfer;
+	while (offset < len) {
+		uint8_t bit_to_send = (len - offset > 7) ? 7 : len - offset;
 		buf[1] = bit_to_send-1;
-		buf[2] = 0x80;
-
-		for (int i = 0; i < bit_to_send; i++, offset++) {
-			buf[2] |=
-			(((tms[offset >> 3] & (1 << (offset & 0x07))) ? 1 : 0) << i);
-		}
+		buf[2] = 0x80 | tms_bits(tms, offset, bit_to_send);
+		offset += bit_to_send;
 		pos+=3;
 
+		/* command may be completed by the next call only when
+		 * not split between two buffers
+		 */
+		_tms_cmd_pos = (_num + 3 <= _buffer_size) ? _num : -1;
 		mpsse_store(buf, 3);
+		_tms_cmd_gen = _write_count;
 		if (pos == iter * 3) {
 			pos = 0;
 			if (mpsse_write() < 0)
@@ -143,7 +179,6 @@ int FtdiJtagMPSSE::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 				}
 			}
 		}
-		xfer -= bit_to_send;
 	}
 	if (flush_buffer)
 		mpsse_write();
@@ -201,16 +236,74 @@ int FtdiJtagMPSSE::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 
 int FtdiJtagMPSSE::flush()
 {
-	return mpsse_write();
+	return mpsse_read_flush();
+}
+
+bool FtdiJtagMPSSE::setDeferredRead(bool enable)
+{
+	/* CH552 must be read back after each command */
+	if (_ch552WA)
+		return false;
+	if (!enable && mpsse_read_flush() < 0)
+		printError("setDeferredRead: fails to resolve pending reads");
+	_deferred_read = enable;
+	return true;
+}
+
+/* constant runs shorter than this are cheaper sent as data */
+#define RLE_MIN_RUN 16
+/* first byte sent as data + 0x10000 bytes with clock-only command */
+#define RLE_MAX_RUN (0x10000 + 1)
+
+/* search, in the first len bytes of buf, for a run of at least
+ * RLE_MIN_RUN bytes equal to 0x00 or 0xff. The run may extend up
+ * to max_len. Returns run offset (len when none) and fills run_len
+ */
+static int find_const_run(const uint8_t *buf, int len, int max_len,
+		int *run_len)
+{
+	int i = 0;
+	while (i < len) {
+		uint8_t val = buf[i];
+		if (val != 0x00 && val != 0xff) {
+			i++;
+			continue;
+		}
+		int j = i + 1;
+		while (j < max_len && buf[j] == val && j - i < RLE_MAX_RUN)
+			j++;
+		if (j - i >= RLE_MIN_RUN) {
+			*run_len = j - i;
+			return i;
+		}
+		i = j;
+	}
+	*run_len = 0;
+	return len;
 }
 
 int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
+{
+	return writeTDIInternal(tdi, tdo, len, 0x01, (last) ? 1 : 0);
+}
+
+int FtdiJtagMPSSE::writeTDIExit(uint8_t *tdi, uint8_t *tdo, uint32_t len,
+		uint8_t tms, uint8_t tms_len)
+{
+	return writeTDIInternal(tdi, tdo, len, tms, tms_len);
+}
+
+int FtdiJtagMPSSE::writeTDIInternal(uint8_t *tdi, uint8_t *tdo, uint32_t len,
+		uint8_t tms, uint8_t tms_len)
 {
 	/* 3 possible case :
 	 *  - n * 8bits to send -> use byte command
 	 *  - less than 8bits   -> use bit command
 	 *  - last bit to send  -> sent in conjunction with TMS
+	 * reads are queued and resolved at the end of the transfer
+	 * (or at flush time when deferred read is enabled)
 	 */
+	bool last = tms_len != 0;
 	int tx_buff_size = mpsse_get_buffer_size();
 	int real_len = (last) ? len - 1 : len;  // if its a buffer in a big send send len
 						// else supress last bit -> with TMS
@@ -229,6 +322,10 @@ int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
 	display("%s len : %d %d %d %d\n", __func__, len, real_len, nb_byte,
 		nb_bit);
 
+	/* a read command can't be bigger than converter FIFO */
+	if (tdo && xfer > mpsse_get_rx_max())
+		xfer = mpsse_get_rx_max();
+
 	if ((nb_byte + _num + 3) > _buffer_size)
 		mpsse_write();
 
@@ -245,98 +342,141 @@ int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
 		nb_bit = 8;
 	}
 
+	/* write only shift: constant (0x00/0xff) runs are replaced by
+	 * clock-only commands (only supported by 2232H, 4232H & 232H).
+	 * The first byte of a run is sent as data: TDI keeps the level of
+	 * the last bit shifted out during the clock only sequence
+	 */
+	bool rle = tdi && !tdo && !_ch552WA &&
+		(_ftdi->type == TYPE_2232H || _ftdi->type == TYPE_4232H ||
+		_ftdi->type == TYPE_232H);
+
 	while (nb_byte != 0) {
 		int xfer_len = (nb_byte > xfer) ? xfer : nb_byte;
+		int run_len = 0;
+		if (rle) {
+			int run = find_const_run(tx_ptr, xfer_len, nb_byte, &run_len);
+			if (run_len != 0)
+				xfer_len = run + 1;
+		}
 		tx_buf[1] = (((xfer_len - 1)     ) & 0xff);  // low
 		tx_buf[2] = (((xfer_len - 1) >> 8) & 0xff);  // high
+		if (tdo) {
+			mpsse_queue_read(rx_ptr, xfer_len);
+			rx_ptr += xfer_len;
+		}
 		mpsse_store(tx_buf, 3);
 		if (tdi) {
 			mpsse_store(tx_ptr, xfer_len);
 			tx_ptr += xfer_len;
 		}
+		nb_byte -= xfer_len;
+		/* remaining part of the run: TDI unchanged */
+		if (run_len > 1) {
+			uint8_t clk_buf[3] = {0x8f,
+				static_cast<uint8_t>((run_len - 2) & 0xff),
+				static_cast<uint8_t>(((run_len - 2) >> 8) & 0xff)};
+			mpsse_store(clk_buf, 3);
+			tx_ptr += run_len - 1;
+			nb_byte -= run_len - 1;
+		}
 		if (tdo) {
-			mpsse_read(rx_ptr, xfer_len);
-			rx_ptr += xfer_len;
+			if (_ch552WA)
+				mpsse_read_flush();
 		} else if (_ch552WA) {
 			mpsse_write();
 			ftdi_read_data(_ftdi, c, xfer_len);
-		} else if (!last) {
+		} else if (!last && (!rle || nb_byte == 0)) {
 			mpsse_write();
 		}
-		nb_byte -= xfer_len;
 	}
 
 	unsigned char last_bit = (tdi) ? *tx_ptr : 0;
-	bool double_write = true;
 
 	if (nb_bit != 0) {
 		display("%s read/write %d bit\n", __func__, nb_bit);
 		tx_buf[0] |= MPSSE_BITMODE;
 		tx_buf[1] = nb_bit - 1;
+		/* realign we have read nb_bit
+		 * since LSB add bit by the left and shift
+		 * we need to complete shift
+		 */
+		if (tdo)
+			mpsse_queue_read(rx_ptr, 1, 8 - nb_bit);
 		mpsse_store(tx_buf, 2);
 		if (tdi) {
 			display("%s last_bit %x size %d\n", __func__, last_bit, nb_bit-1);
 			mpsse_store(last_bit);
 		}
-		if (tdo && !last) {
-			mpsse_read(rx_ptr, 1);
-			double_write = false;
-			/* realign we have read nb_bit
-			 * since LSB add bit by the left and shift
-			 * we need to complete shift
-			 */
-			*rx_ptr >>= (8 - nb_bit);
-			display("%s %x\n", __func__, *rx_ptr);
+		if (tdo) {
+			if (_ch552WA)
+				mpsse_read_flush();
 		} else if (_ch552WA) {
-			if (tdo) {
-				mpsse_read(rx_ptr, 1);
-				double_write = false;
-				*rx_ptr >>= (8 - nb_bit);
-			} else {
-				mpsse_write();
-				ftdi_read_data(_ftdi, c, nb_bit);
-			}
+			mpsse_write();
+			ftdi_read_data(_ftdi, c, nb_bit);
 		} else if (!last) {
 			mpsse_write();
 		}
+		/* a full byte sent with bit command: last bit is
+		 * the first of the next byte
+		 */
+		if (nb_bit == 8) {
+			nb_bit = 0;
+			if (tdi)
+				tx_ptr++;
+			if (tdo)
+				rx_ptr++;
+		}
 	}
 
-	/* display : must be dropped */
-	if (_verbose && tdo) {
-		display("\n");
-		for (int i = (len / 8) - 1; i >= 0; i--)
-			display("%x ", (unsigned char)tdo[i]);
-		display("\n");
-	}
-
-	if (last == 1) {
+	if (last) {
+		/* up to 7 TMS bits in one command (bit 7 is TDI state),
+		 * CH552 WA: only exit bit
+		 */
+		uint8_t tms_xfer = (tms_len > 7) ? 7 : tms_len;
+		if (_ch552WA)
+			tms_xfer = 1;
 		last_bit = (tdi)? (*tx_ptr & (1 << nb_bit)) : 0;
 
 		display("%s move to EXIT1_xx and send last bit %x\n", __func__, (last_bit?0x81:0x01));
 		/* write the last bit in conjunction with TMS */
 		tx_buf[0] = MPSSE_WRITE_TMS | MPSSE_LSB | MPSSE_BITMODE | _write_mode |
 					((tdo) ? (MPSSE_DO_READ | _read_mode) : 0);
-		tx_buf[1] = 0x0;  // send 1bit
-		tx_buf[2] = ((last_bit) ? 0x81 : 0x01);  // we know in TMS tdi is bit 7
-							// and to move to EXIT_XR TMS = 1
+		tx_buf[1] = tms_xfer - 1;  // number of TMS bits
+		/* we know in TMS tdi is bit 7 and first TMS bit
+		 * (always high) move to EXIT_XR
+		 */
+		tx_buf[2] = ((last_bit) ? 0x80 : 0x00) | (tms & ((1 << tms_xfer) - 1));
+		if (tdo) {
+			/* no previous bit read: byte must be cleared before merge */
+			if (nb_bit == 0)
+				*rx_ptr = 0;
+			/* last TDI bit is the first one received: since LSB
+			 * add bit by the left after tms_xfer cycles it's
+			 * bit 8 - tms_xfer
+			 */
+			mpsse_queue_read_bit(rx_ptr, 8 - tms_xfer, nb_bit);
+		}
 		mpsse_store(tx_buf, 3);
 		if (tdo) {
-			unsigned char c[2];
-			int index = 0;
-			mpsse_read(c, 1 + ((double_write)?1:0));
-			if (double_write) {
-				*rx_ptr = c[index] >> (8-nb_bit);
-				index++;
-			}
-			/* in this case for 1 one it's always bit 7 */
-			*rx_ptr |= ((c[index] & 0x80) << (7 - nb_bit));
+			if (_ch552WA)
+				mpsse_read_flush();
 		} else if (_ch552WA) {
 			mpsse_write();
 			ftdi_read_data(_ftdi, c, 1);
 		} else {
 			mpsse_write();
 		}
+
+		/* remaining part of the path */
+		if (tms_len > tms_xfer) {
+			uint8_t tail = tms >> tms_xfer;
+			writeTMS(&tail, tms_len - tms_xfer, false);
+		}
 	}
 
+	if (tdo && !_deferred_read)
+		return (mpsse_read_flush() < 0) ? -1 : 0;
+
 	return 0;
 }
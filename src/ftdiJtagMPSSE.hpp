@@ -36,6 +36,9 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
 	/* TDI */
 	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
+	int writeTDIExit(uint8_t *tx, uint8_t *rx, uint32_t len,
+		uint8_t tms, uint8_t tms_len) override;
+	bool setDeferredRead(bool enable) override;
 
 	/*!
 	 * \brief return internal buffer size (in byte).
@@ -55,7 +58,16 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 	 *        pos is used for write and neg to sample
 	 */
 	void config_edge();
+	/*!
+	 * \brief send TDI bits, when tms_len > 0 last bit is sent with up to
+	 *        7 TMS bits of tms (remaining bits are sent with writeTMS)
+	 */
+	int writeTDIInternal(uint8_t *tx, uint8_t *rx, uint32_t len,
+		uint8_t tms, uint8_t tms_len);
 	bool _ch552WA; /* avoid errors with SiPeed tangNano */
+	bool _deferred_read; /**< rx buffers filled at flush time */
+	int _tms_cmd_pos; /**< offset of last TMS command in _buffer (-1: none) */
+	uint32_t _tms_cmd_gen; /**< _write_count when this command was stored */
 	uint8_t _write_mode; /**< write edge configuration */
 	uint8_t _read_mode; /**< read edge configuration */
 };
@@ -26,12 +26,20 @@ using namespace std;
 #define display(...) \
 	do { if (_verbose) fprintf(stdout, __VA_ARGS__);}while(0)
 
+/* read pipeline: number of IN transfers and packets by transfer */
+#define MPSSE_RX_XFERS   4
+#define MPSSE_RX_PACKETS 16
+
 FTDIpp_MPSSE::FTDIpp_MPSSE(const mpsse_bit_config &cable, const string &dev,
 				const std::string &serial, uint32_t clkHZ, int8_t verbose):
 				_verbose(verbose > 1), _cable(cable), _vid(0),
 				_pid(0), _bus(-1), _addr(-1),
 				_interface(cable.interface),
-				_clkHZ(clkHZ), _buffer_size(2*32768), _num(0)
+				_rx_slot_idx(0), _rx_slot_off(0), _rx_error(false),
+				_clkHZ(clkHZ), _buffer_size(2*32768), _num(0),
+				_write_count(0),
+				_async_write(false), _async_buffer(NULL), _async_tc(NULL),
+				_async_len(0), _rx_pending(0), _rx_max(256)
 {
 	strcpy(_product, "");
 	if (!dev.empty()) {
@@ -45,10 +53,28 @@ FTDIpp_MPSSE::FTDIpp_MPSSE(const mpsse_bit_config &cable, const string &dev,
 	}
 
 	open_device(serial, 115200);
-	_buffer_size = _ftdi->max_packet_size;
 
+	/* read commands can't be queued beyond converter's TX FIFO
+	 * (when full the MPSSE engine stops until host read)
+	 */
+	switch (_ftdi->type) {
+	case TYPE_2232H:
+	case TYPE_4232H:
+		_rx_max = 4096;
+		break;
+	case TYPE_232H:
+		_rx_max = 1024;
+		break;
+	default:
+		_rx_max = 256;
+	}
+
+	/* command buffer is not limited to USB max packet size:
+	 * libftdi splits transfer in chunks
+	 */
 	_buffer = (unsigned char *)malloc(sizeof(unsigned char) * _buffer_size);
-	if (!_buffer) {
+	_async_buffer = (unsigned char *)malloc(sizeof(unsigned char) * _buffer_size);
+	if (!_buffer || !_async_buffer) {
 		cout << "_buffer malloc failed" << endl;
 		throw std::runtime_error("_buffer malloc failed");
 	}
@@ -66,11 +92,17 @@ FTDIpp_MPSSE::FTDIpp_MPSSE(const mpsse_bit_config &cable, const string &dev,
 
 FTDIpp_MPSSE::~FTDIpp_MPSSE()
 {
+	mpsse_write_wait();
+	for (auto xfer : _rx_xfers) {
+		free(xfer->buffer);
+		libusb_free_transfer(xfer);
+	}
 	ftdi_set_bitmode(_ftdi, 0, BITMODE_RESET);
 
 	ftdi_usb_reset(_ftdi);
 	close_device();
 	free(_buffer);
+	free(_async_buffer);
 }
 
 void FTDIpp_MPSSE::open_device(const std::string &serial, unsigned int baudrate)
@@ -302,7 +334,7 @@ int FTDIpp_MPSSE::setClkFreq(uint32_t clkHZ)
 
 	mpsse_store(buffer, 3);
 	ret = mpsse_write();
-	if (ret < 0) {
+	if (ret < 0 || mpsse_write_wait() < 0) {
 		fprintf(stderr, "Error: write for frequency return %d\n", ret);
 		return -1;
 	}
@@ -370,45 +402,269 @@ int FTDIpp_MPSSE::mpsse_write()
 	display("%s %d\n", __func__, _num);
 #endif
 
-	if ((ret = ftdi_write_data(_ftdi, _buffer, _num)) != _num) {
-		cout << "write error: " << ret << " instead of " << _num << endl;
+	if (!_async_write) {
+		if ((ret = ftdi_write_data(_ftdi, _buffer, _num)) != _num) {
+			cout << "write error: " << ret << " instead of " << _num << endl;
+			return ret;
+		}
+		_num = 0;
+		_write_count++;
 		return ret;
 	}
 
+	/* previous transfer must be done before reusing its buffer */
+	if (mpsse_write_wait() < 0)
+		return -1;
+
+	_async_tc = ftdi_write_data_submit(_ftdi, _buffer, _num);
+	if (!_async_tc) {
+		cout << "write error: submit fails" << endl;
+		return -1;
+	}
+	_async_len = _num;
+
+	/* next commands are stored in the other buffer */
+	unsigned char *tmp = _buffer;
+	_buffer = _async_buffer;
+	_async_buffer = tmp;
+
+	ret = _num;
 	_num = 0;
+	_write_count++;
+
+	/* commands with read are sent: drain converter FIFO */
+	if (_rx_slot_idx < _rx_slots.size() && mpsse_rx_start() < 0)
+		return -1;
 	return ret;
 }
 
+int FTDIpp_MPSSE::mpsse_write_wait()
+{
+	if (!_async_tc)
+		return 0;
+
+	int ret = ftdi_transfer_data_done(_async_tc);
+	_async_tc = NULL;
+	if (ret != _async_len) {
+		cout << "write error: " << ret << " instead of " << _async_len << endl;
+		return -1;
+	}
+	return 0;
+}
+
 int FTDIpp_MPSSE::mpsse_read(unsigned char *rx_buff, int len)
 {
-	int n;
-	int num_read = 0;
-	unsigned char *p = rx_buff;
+	/* pending reads are sent before: register this read after
+	 * them and resolve all
+	 */
+	if (mpsse_queue_read(rx_buff, len) < 0)
+		return -1;
+	if (mpsse_read_flush() < 0)
+		return -1;
+	return len;
+}
+
+int FTDIpp_MPSSE::mpsse_queue_read(unsigned char *rx_buff, int len,
+		uint8_t shift)
+{
+	/* converter FIFO can't store more: resolve already queued reads
+	 * (with read pipeline FIFO is drained while commands are sent)
+	 */
+	if (!_async_write && !_rx_slots.empty() && _rx_pending + len > _rx_max) {
+		if (mpsse_read_flush() < 0)
+			return -1;
+	}
+	_rx_slots.push_back({rx_buff, len, shift, false, 0, 0});
+	_rx_pending += len;
+	return 0;
+}
+
+int FTDIpp_MPSSE::mpsse_queue_read_bit(unsigned char *rx_buff,
+		uint8_t src_bit, uint8_t dst_bit)
+{
+	if (mpsse_queue_read(rx_buff, 1) < 0)
+		return -1;
+	mpsse_rx_slot_t &slot = _rx_slots.back();
+	slot.merge = true;
+	slot.src_bit = src_bit;
+	slot.dst_bit = dst_bit;
+	return 0;
+}
+
+int FTDIpp_MPSSE::mpsse_read_flush()
+{
+	int ret = 0;
+
+	if (_rx_slots.empty())
+		return (mpsse_write() < 0) ? -1 : 0;
 
 	/* force buffer transmission before read */
 	mpsse_store(SEND_IMMEDIATE);
 	if (mpsse_write() == -1)
 		printError("mpsse_read: fails to write");
 
-	do {
-		n = ftdi_read_data(_ftdi, p, len);
-		if (n < 0) {
-			fprintf(stderr, "Error: ftdi_read_data in %s", __func__);
-			return -1;
+	if (_async_write) {
+		ret = mpsse_rx_wait();
+	} else {
+		unsigned char tmp[512];
+		int len = _rx_pending;
+		while (len > 0) {
+			int n = ftdi_read_data(_ftdi, tmp,
+				(len > (int)sizeof(tmp)) ? (int)sizeof(tmp) : len);
+			if (n < 0) {
+				fprintf(stderr, "Error: ftdi_read_data in %s", __func__);
+				ret = -1;
+				break;
+			}
+			mpsse_rx_dispatch(tmp, n);
+			len -= n;
 		}
+	}
+
+	_rx_slots.clear();
+	_rx_slot_idx = 0;
+	_rx_slot_off = 0;
+	_rx_pending = 0;
+
+	/* read may complete before write callback is reaped */
+	if (mpsse_write_wait() < 0)
+		ret = -1;
+	return ret;
+}
+
+void FTDIpp_MPSSE::mpsse_rx_dispatch(const unsigned char *data, int len)
+{
 #ifdef DEBUG
-		if (_verbose) {
-			display("%s %d\n", __func__, n);
-			for (int i = 0; i < n; i++)
-				display("\t%s %x\n", __func__, p[i]);
-		}
+	if (_verbose) {
+		display("%s %d\n", __func__, len);
+		for (int i = 0; i < len; i++)
+			display("\t%s %x\n", __func__, data[i]);
+	}
 #endif
+	while (len > 0 && _rx_slot_idx < _rx_slots.size()) {
+		mpsse_rx_slot_t &slot = _rx_slots[_rx_slot_idx];
+		int xfer = slot.len - _rx_slot_off;
+		if (xfer > len)
+			xfer = len;
+		if (slot.merge)
+			slot.ptr[0] |= ((data[0] >> slot.src_bit) & 0x01) << slot.dst_bit;
+		else
+			memcpy(slot.ptr + _rx_slot_off, data, xfer);
+		_rx_slot_off += xfer;
+		data += xfer;
+		len -= xfer;
+
+		if (_rx_slot_off == slot.len) {
+			if (!slot.merge && slot.shift != 0)
+				slot.ptr[slot.len - 1] >>= slot.shift;
+			_rx_slot_idx++;
+			_rx_slot_off = 0;
+		}
+	}
+	if (len > 0)
+		printWarn("mpsse_read: " + std::to_string(len) + " unexpected bytes");
+}
+
+void LIBUSB_CALL FTDIpp_MPSSE::mpsse_rx_callback(struct libusb_transfer *transfer)
+{
+	FTDIpp_MPSSE *self = static_cast<FTDIpp_MPSSE *>(transfer->user_data);
+	int pkt_size = self->_ftdi->max_packet_size;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		/* each packet starts with two modem status bytes */
+		for (int off = 0; off < transfer->actual_length; off += pkt_size) {
+			int n = transfer->actual_length - off;
+			if (n > pkt_size)
+				n = pkt_size;
+			if (n > 2)
+				self->mpsse_rx_dispatch(transfer->buffer + off + 2, n - 2);
+		}
+	} else if (transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+		self->_rx_error = true;
+	}
+
+	/* reads still pending: resubmit at once so the converter FIFO
+	 * keeps being drained while the caller waits for a write
+	 * (otherwise the FIFO fills, MPSSE stops and the write stalls)
+	 */
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED && !self->_rx_error &&
+			self->_rx_slot_idx < self->_rx_slots.size()) {
+		if (libusb_submit_transfer(transfer) == 0)
+			return;
+		printError("mpsse_read: fails to submit transfer");
+		self->_rx_error = true;
+	}
+	self->_rx_idle.push_back(transfer);
+}
+
+int FTDIpp_MPSSE::mpsse_rx_start()
+{
+	/* transfers are allocated at first use */
+	if (_rx_xfers.empty()) {
+		int xfer_size = MPSSE_RX_PACKETS * _ftdi->max_packet_size;
+		for (int i = 0; i < MPSSE_RX_XFERS; i++) {
+			struct libusb_transfer *xfer = libusb_alloc_transfer(0);
+			unsigned char *buf = (unsigned char *)malloc(xfer_size);
+			if (!xfer || !buf) {
+				printError("mpsse_read: transfer allocation failed");
+				free(buf);
+				libusb_free_transfer(xfer);
+				return -1;
+			}
+			/* ftdi_context out_ep is the IN endpoint */
+			libusb_fill_bulk_transfer(xfer, _ftdi->usb_dev, _ftdi->out_ep,
+				buf, xfer_size, mpsse_rx_callback, this,
+				_ftdi->usb_read_timeout);
+			_rx_xfers.push_back(xfer);
+			_rx_idle.push_back(xfer);
+		}
+	}
+
+	while (!_rx_error && !_rx_idle.empty() &&
+			_rx_slot_idx < _rx_slots.size()) {
+		struct libusb_transfer *xfer = _rx_idle.back();
+		if (libusb_submit_transfer(xfer) < 0) {
+			printError("mpsse_read: fails to submit transfer");
+			_rx_error = true;
+			return -1;
+		}
+		_rx_idle.pop_back();
+	}
+	return 0;
+}
 
-		len -= n;
-		p += n;
-		num_read += n;
-	} while (len > 0);
-	return num_read;
+int FTDIpp_MPSSE::mpsse_rx_wait()
+{
+	struct timeval tv = {0, 100000};
+	int stall = 0, ret = 0;
+
+	while (!_rx_error && _rx_slot_idx < _rx_slots.size()) {
+		size_t idx = _rx_slot_idx;
+		int off = _rx_slot_off;
+		if (mpsse_rx_start() < 0)
+			break;
+		libusb_handle_events_timeout_completed(_ftdi->usb_ctx, &tv, NULL);
+		/* no data since usb_read_timeout: give up */
+		if (idx == _rx_slot_idx && off == _rx_slot_off) {
+			if (++stall * 100 > _ftdi->usb_read_timeout) {
+				printError("mpsse_read: timeout");
+				_rx_error = true;
+			}
+		} else {
+			stall = 0;
+		}
+	}
+	if (_rx_error)
+		ret = -1;
+
+	/* all expected bytes are received: stop remaining transfers */
+	for (auto xfer : _rx_xfers)
+		libusb_cancel_transfer(xfer);
+	while (_rx_idle.size() != _rx_xfers.size())
+		libusb_handle_events_timeout_completed(_ftdi->usb_ctx, &tv, NULL);
+
+	_rx_error = false;
+	return ret;
 }
 
 /**
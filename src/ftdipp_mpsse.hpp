@@ -7,6 +7,7 @@
 #define _FTDIPP_MPSSE_H
 #include <ftdi.h>
 #include <string>
+#include <vector>
 
 class FTDIpp_MPSSE {
 	public:
@@ -61,7 +62,42 @@ class FTDIpp_MPSSE {
 		void ftdi_usb_close_internal();
 		int close_device();
 		int mpsse_write();
+		/*!
+		 * \brief wait until buffer submitted by mpsse_write() (async
+		 *        mode) is fully sent
+		 * \return -1 when transfer fails, 0 otherwise
+		 */
+		int mpsse_write_wait();
 		int mpsse_read(unsigned char *rx_buff, int len);
+		/*!
+		 * \brief register a read of len bytes: rx_buff is filled by
+		 *        mpsse_read_flush(). Must be called before storing the
+		 *        command producing these bytes
+		 * \param[in] rx_buff: destination buffer
+		 * \param[in] len: number of bytes
+		 * \param[in] shift: right shift applied to the last received byte
+		 * \return -1 when pending reads flush fails, 0 otherwise
+		 */
+		int mpsse_queue_read(unsigned char *rx_buff, int len,
+			uint8_t shift = 0);
+		/*!
+		 * \brief register a one byte read where only one bit is kept:
+		 *        bit src_bit of received byte is ored into bit dst_bit
+		 *        of rx_buff[0]
+		 * \return -1 when pending reads flush fails, 0 otherwise
+		 */
+		int mpsse_queue_read_bit(unsigned char *rx_buff, uint8_t src_bit,
+			uint8_t dst_bit);
+		/*!
+		 * \brief send buffer and fill all pending read buffers
+		 * \return -1 when write or read fails, 0 otherwise
+		 */
+		int mpsse_read_flush();
+		/*!
+		 * \brief max number of bytes to request by read command: unbounded
+		 *        when reads are pipelined
+		 */
+		int mpsse_get_rx_max() {return (_async_write) ? _buffer_size : _rx_max;}
 		int mpsse_store(unsigned char c);
 		int mpsse_store(unsigned char *c, int len);
 		int mpsse_get_buffer_size() {return _buffer_size;}
@@ -78,12 +114,57 @@ class FTDIpp_MPSSE {
 		unsigned char _interface;
 		/* gpio */
 		bool __gpio_write(bool low_pins);
+		/* read pipeline (async mode): some IN transfers stay submitted
+		 * to drain converter FIFO while commands are still sent
+		 */
+		static void LIBUSB_CALL mpsse_rx_callback(struct libusb_transfer *transfer);
+		/*!
+		 * \brief copy received bytes to pending read slots
+		 */
+		void mpsse_rx_dispatch(const unsigned char *data, int len);
+		/*!
+		 * \brief submit idle IN transfers while reads are pending
+		 * \return -1 when submit fails, 0 otherwise
+		 */
+		int mpsse_rx_start();
+		/*!
+		 * \brief wait until all pending reads are filled then cancel
+		 *        remaining IN transfers
+		 * \return -1 on error/timeout, 0 otherwise
+		 */
+		int mpsse_rx_wait();
+		std::vector<struct libusb_transfer *> _rx_xfers; /*!< IN transfers */
+		std::vector<struct libusb_transfer *> _rx_idle;  /*!< not submitted */
+		size_t _rx_slot_idx; /*!< slot currently filled */
+		int _rx_slot_off;    /*!< offset in current slot */
+		bool _rx_error;      /*!< IN transfer failure */
 	protected:
 		uint32_t _clkHZ;
 		struct ftdi_context *_ftdi;
 		int _buffer_size;
 		int _num;
+		uint32_t _write_count; /*!< incremented each time _buffer is sent */
 		unsigned char *_buffer;
+		/* double buffering: with _async_write mpsse_write() submits
+		 * _buffer and continues with _async_buffer while the previous
+		 * transfer is in flight
+		 */
+		bool _async_write;
+		unsigned char *_async_buffer; /*!< buffer used by pending transfer */
+		struct ftdi_transfer_control *_async_tc; /*!< pending transfer */
+		int _async_len; /*!< pending transfer size */
+		/* deferred read */
+		typedef struct {
+			unsigned char *ptr; /*!< destination buffer */
+			int len;            /*!< number of bytes */
+			uint8_t shift;      /*!< right shift applied to last byte */
+			bool merge;         /*!< or one received bit into ptr[0] */
+			uint8_t src_bit;    /*!< merge: received bit */
+			uint8_t dst_bit;    /*!< merge: destination bit */
+		} mpsse_rx_slot_t;
+		std::vector<mpsse_rx_slot_t> _rx_slots; /*!< pending reads */
+		int _rx_pending; /*!< number of bytes to read */
+		int _rx_max;     /*!< converter TX FIFO size (sync mode bound) */
 		uint8_t _iproduct[200];
 };
 
@@ -8,6 +8,9 @@
 #include <ftdi.h>
 #include <unistd.h>
 #include <string.h>
+
+#include <vector>
+
 #include "board.hpp"
 #include "ftdipp_mpsse.hpp"
 #include "ftdispi.hpp"
@@ -78,6 +81,7 @@ FtdiSpi::FtdiSpi(int vid, int pid, unsigned char interface, uint32_t clkHZ,
 	setEndianness(SPI_MSB_FIRST);
 
 	init(1, 0x00, BITMODE_MPSSE);
+	_async_write = true;
 }
 
 FtdiSpi::FtdiSpi(const FTDIpp_MPSSE::mpsse_bit_config &conf,
@@ -106,6 +110,7 @@ FtdiSpi::FtdiSpi(const FTDIpp_MPSSE::mpsse_bit_config &conf,
 	setEndianness(SPI_MSB_FIRST);
 
 	init(1, 0x00, BITMODE_MPSSE);
+	_async_write = true;
 }
 
 FtdiSpi::~FtdiSpi()
@@ -140,6 +145,32 @@ bool FtdiSpi::clearCs()
 	return confCs(_cs);
 }
 
+void FtdiSpi::storeCs(char stat)
+{
+	_cs = (stat == 0) ? 0x00 : _cs_bits;
+	if (stat == 0) {
+		_cable.bit_low_val &= ~(0xff & _cs_bits);
+		_cable.bit_high_val &= ~(0xff & (_cs_bits >> 8));
+	} else {
+		_cable.bit_low_val |= (0xff & _cs_bits);
+		_cable.bit_high_val |= (0xff & (_cs_bits >> 8));
+	}
+	for (int i = 0; i < 2; i++) {
+		if (_cs_bits & 0x00ff) {
+			uint8_t tx[3] = {SET_BITS_LOW,
+				static_cast<uint8_t>(_cable.bit_low_val),
+				static_cast<uint8_t>(_cable.bit_low_dir)};
+			mpsse_store(tx, 3);
+		}
+		if (_cs_bits & 0xff00) {
+			uint8_t tx[3] = {SET_BITS_HIGH,
+				static_cast<uint8_t>(_cable.bit_high_val),
+				static_cast<uint8_t>(_cable.bit_high_dir)};
+			mpsse_store(tx, 3);
+		}
+	}
+}
+
 int FtdiSpi::ft2232_spi_wr_then_rd(
 						const uint8_t *tx_data, uint32_t tx_len,
 						uint8_t *rx_data, uint32_t rx_len)
@@ -165,8 +196,9 @@ int FtdiSpi::ft2232_spi_wr_and_rd(//struct ftdi_spi *spi,
 			    uint32_t writecnt,
 			    const uint8_t * writearr, uint8_t * readarr)
 {
-	uint32_t max_xfer = (readarr) ? _buffer_size : 4096;
-	uint8_t buf[max_xfer];
+	/* a read can't exceed converter FIFO unless reads are pipelined */
+	uint32_t max_xfer = (readarr) ? mpsse_get_rx_max() : 4096;
+	std::vector<uint8_t> buf(max_xfer + 3);
 	int i = 0;
 	int ret = 0;
 
@@ -194,23 +226,24 @@ int FtdiSpi::ft2232_spi_wr_and_rd(//struct ftdi_spi *spi,
 		buf[i++] = (xfer - 1) & 0xff;
 		buf[i++] = ((xfer - 1) >> 8) & 0xff;
 		if (writearr) {
-			memcpy(buf + i, tx_ptr, xfer);
+			memcpy(buf.data() + i, tx_ptr, xfer);
 			tx_ptr += xfer;
 			i += xfer;
 		}
 
-		ret = mpsse_store(buf, i);
+		/* reads are queued: all chunks are received in one pass,
+		 * while next commands are sent
+		 */
+		if (readarr) {
+			mpsse_queue_read(rx_ptr, xfer);
+			rx_ptr += xfer;
+		}
+
+		ret = mpsse_store(buf.data(), i);
 		if (ret)
 			printf("send_buf failed before read: %i %s\n", ret, ftdi_get_error_string(_ftdi));
 		i = 0;
-		if (readarr) {
-			//if (ret == 0) {
-			ret = mpsse_read(rx_ptr, xfer);
-			if ((uint32_t)ret != xfer)
-				printf("get_buf failed: %i\n", ret);
-			//}
-			rx_ptr += xfer;
-		} else {
+		if (!readarr) {
 			ret = mpsse_write();
 			if ((uint32_t)ret != xfer+3)
 				printf("error %d %d\n", ret, i);
@@ -219,6 +252,9 @@ int FtdiSpi::ft2232_spi_wr_and_rd(//struct ftdi_spi *spi,
 
 	}
 
+	if (readarr && mpsse_read_flush() < 0)
+		printf("get_buf failed\n");
+
 	if (_cs_mode == SPI_CS_AUTO) {
 		if (!setCs())
 			printf("send_buf failed at write %d\n", ret);
@@ -231,25 +267,81 @@ int FtdiSpi::ft2232_spi_wr_and_rd(//struct ftdi_spi *spi,
 int FtdiSpi::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
 	uint32_t xfer_len = len + 1;
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
+	std::vector<uint8_t> jtx(xfer_len);
+	std::vector<uint8_t> jrx(xfer_len);
 
 	jtx[0] = cmd;
 	if (tx != NULL)
-		memcpy(jtx+1, tx, len);
+		memcpy(jtx.data()+1, tx, len);
 
 	/* send first alreay stored cmd,
 	 * in the same time store each byte
 	 * to next
 	 */
-	ft2232_spi_wr_and_rd(xfer_len, jtx, (rx != NULL)?jrx:NULL);
+	ft2232_spi_wr_and_rd(xfer_len, jtx.data(), (rx != NULL)?jrx.data():NULL);
 
 	if (rx != NULL)
-		memcpy(rx, jrx+1, len);
+		memcpy(rx, jrx.data()+1, len);
 
 	return 0;
 }
 
+/* method spiInterface::spi_put_batch
+ * CS updates, commands and reads of all transactions are stored in
+ * the same MPSSE stream: one write and one read pass for the batch
+ */
+int FtdiSpi::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	const uint32_t max_xfer = mpsse_get_rx_max();
+	std::vector<uint8_t> zero;
+	bool has_rx = false;
+
+	for (auto &x : xfers) {
+		const uint8_t *tx_ptr = x.tx;
+		uint8_t *rx_ptr = x.rx;
+		uint32_t len = x.len;
+
+		storeCs(0);
+		uint8_t cmd[4] = {static_cast<uint8_t>(MPSSE_DO_WRITE | _wr_mode),
+			0, 0, x.cmd};
+		mpsse_store(cmd, 4);
+
+		while (len > 0) {
+			uint32_t xfer = (len > max_xfer) ? max_xfer : len;
+			/* clock out 0x00 when nothing to send and nothing to read */
+			const uint8_t *wr = tx_ptr;
+			if (!wr && !rx_ptr) {
+				zero.resize(xfer, 0);
+				wr = zero.data();
+			}
+
+			uint8_t hdr[3] = {
+				static_cast<uint8_t>(((rx_ptr) ? (MPSSE_DO_READ | _rd_mode) : 0) |
+					((wr) ? (MPSSE_DO_WRITE | _wr_mode) : 0)),
+				static_cast<uint8_t>((xfer - 1) & 0xff),
+				static_cast<uint8_t>(((xfer - 1) >> 8) & 0xff)};
+			if (rx_ptr) {
+				mpsse_queue_read(rx_ptr, xfer);
+				rx_ptr += xfer;
+				has_rx = true;
+			}
+			mpsse_store(hdr, 3);
+			if (wr) {
+				mpsse_store(const_cast<uint8_t *>(wr), xfer);
+				if (tx_ptr)
+					tx_ptr += xfer;
+			}
+			len -= xfer;
+		}
+
+		storeCs(1);
+	}
+
+	if (has_rx)
+		return (mpsse_read_flush() < 0) ? -1 : 0;
+	return (mpsse_write() < 0) ? -1 : 0;
+}
+
 /* method spiInterface::spi_put */
 int FtdiSpi::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 {
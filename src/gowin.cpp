@@ -12,6 +12,7 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include "jtag.hpp"
 #include "gowin.hpp"
@@ -404,18 +405,38 @@ bool Gowin::pollFlag(uint32_t mask, uint32_t value)
 {
 	uint32_t status;
 	int timeout = 0;
+	uint8_t cmd = STATUS_REGISTER;
+	uint8_t tx[4] = {0, 0, 0, 0};
+	/* status register is read by batches: one round trip
+	 * for many read (extra reads are harmless)
+	 */
+	const int batch_size = 16;
+	int handles[batch_size];
 	do {
-		status = readStatusReg();
-		if (_verbose)
-			printf("pollFlag: %x\n", status);
-		if (timeout == 100000000){
-			printError("timeout");
+		_jtag->queue_begin();
+		for (int i = 0; i < batch_size; i++) {
+			_jtag->shiftIR(&cmd, NULL, 8);
+			_jtag->toggleClk(6);
+			handles[i] = _jtag->queue_shiftDR(tx, 32);
+			_jtag->toggleClk(6);
+		}
+		if (_jtag->queue_flush() < 0) {
+			printError("pollFlag: read failure");
 			return false;
 		}
-		timeout++;
-	} while ((status & mask) != value);
+		for (int i = 0; i < batch_size; i++) {
+			const uint8_t *rx = _jtag->queue_tdo(handles[i]);
+			status = rx[3] << 24 | rx[2] << 16 | rx[1] << 8 | rx[0];
+			if (_verbose)
+				printf("pollFlag: %x\n", status);
+			if ((status & mask) == value)
+				return true;
+		}
+		timeout += batch_size;
+	} while (timeout < 100000000);
 
-	return true;
+	printError("timeout");
+	return false;
 }
 
 /* TN653 p. 17-21 */
@@ -621,16 +642,71 @@ bool Gowin::eraseSRAM()
 
 int Gowin::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	uint8_t jrx[len+1], jtx[len+1];
-	jtx[0] = cmd;
-	if (tx)
-		memcpy(jtx+1, tx, len);
-	else
-		memset(jtx+1, 0, len);
-	int ret = spi_put(jtx, (rx)? jrx : NULL, len+1);
-	if (rx)
-		memcpy(rx, jrx+1, len);
-	return ret;
+	return spi_put_batch({{cmd, tx, rx, len}});
+}
+
+/* DO is sampled once per bit: samples are captured at queue_flush()
+ * so the whole batch is sent in one stream instead of one flush
+ * per bit
+ */
+int Gowin::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	std::vector<std::vector<uint8_t>> samples(xfers.size());
+	bool has_rx = false;
+
+	for (auto &x : xfers)
+		has_rx |= x.rx != NULL;
+	if (has_rx)
+		_jtag->queue_begin();
+
+	for (size_t i = 0; i < xfers.size(); i++) {
+		const spi_xfer_t &x = xfers[i];
+		if (x.rx)
+			samples[i].resize(8 * x.len);
+
+		/* set CS/SCK/DI low */
+		uint8_t t = _spi_msk | _spi_do;
+		t &= ~_spi_cs;
+		spi_gowin_write(&t, NULL, 8);
+
+		/* send bit/bit cmd + tx content (or set di to 0 when NULL) */
+		for (uint32_t b = 0; b < (x.len + 1) * 8; b++) {
+			const uint8_t byte = (b < 8) ? x.cmd :
+				((x.tx != NULL) ? x.tx[(b >> 3) - 1] : 0);
+			t = _spi_msk | _spi_do;
+			if (byte & (1 << (7 - (b & 0x07))))
+				t |= _spi_di;
+			spi_gowin_write(&t, NULL, 8);
+			t |= _spi_sck;
+			spi_gowin_write(&t, (x.rx && b >= 8) ? &samples[i][b - 8] : NULL, 8);
+		}
+		/* set CS and unset SCK (next xfer) */
+		t &= ~_spi_sck;
+		t |= _spi_cs;
+		spi_gowin_write(&t, NULL, 8);
+	}
+
+	if (!has_rx) {
+		_jtag->flush();
+		return 0;
+	}
+	if (_jtag->queue_flush() != 0)
+		return -1;
+
+	/* reconstruct bytes */
+	for (size_t i = 0; i < xfers.size(); i++) {
+		const spi_xfer_t &x = xfers[i];
+		if (x.rx == NULL)
+			continue;
+		for (uint32_t j = 0; j < x.len; j++) {
+			uint8_t v = 0;
+			for (int b = 0; b < 8; b++)
+				if (samples[i][8 * j + b] & _spi_do)
+					v |= 1 << (7 - b);
+			x.rx[j] = v;
+		}
+	}
+	return 0;
 }
 
 int Gowin::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
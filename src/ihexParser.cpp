@@ -4,7 +4,6 @@
  */
 
 
-#include <sstream>
 #include <string>
 
 #include "configBitstreamParser.hpp"
@@ -13,14 +12,6 @@
 
 using namespace std;
 
-/* line format
- * :LLAAAATTHH...HHCC
- * LL   : nb octets de data dans la ligne (hexa)
- * AAAA : addresse du debut de la ligne ou mettre les data 
- * TT   : type de la ligne (cf. plus bas)
- * HH   : le champ de data
- * CC   : Checksum (cf. plus bas)
- */
 /* type : 00 -> data + addr 16b
  *        01 -> end of file
  *        02 -> extended addr
@@ -29,11 +20,6 @@ using namespace std;
  *        05 -> start linear addr record
  */
 
-#define LEN_BASE  1
-#define ADDR_BASE 3
-#define TYPE_BASE 7
-#define DATA_BASE 9
-
 IhexParser::IhexParser(const string &filename, bool reverseOrder, bool verbose):
 		ConfigBitstreamParser(filename, ConfigBitstreamParser::ASCII_MODE,
 		verbose),
@@ -42,50 +28,49 @@ IhexParser::IhexParser(const string &filename, bool reverseOrder, bool verbose):
 
 int IhexParser::parse()
 {
-	string str;
-	istringstream lineStream(_raw_data);
+	hex_record_t rec;
+	size_t pos = 0;
 
 	uint16_t next_addr = 0;
 	bool is_first = true;
 	data_line_t cnt;
 	cnt.length = 0;
 
-	while (std::getline(lineStream, str, '\n')) {
-		char *ptr;
-		uint8_t sum = 0;
-		uint16_t tmp, byteLen, type, checksum;
-		uint32_t addr, loc_addr;
+	while (pos < _raw_data.size()) {
+		const char *line = &_raw_data[pos];
+		size_t end = _raw_data.find('\n', pos);
+		if (end == string::npos)
+			end = _raw_data.size();
+		size_t len = end - pos;
+		pos = end + 1;
 
 		/* if '\r' is present -> drop */
-		if (str.back() == '\r')
-			str.pop_back();
+		if (len > 0 && line[len - 1] == '\r')
+			len--;
+		if (len == 0)
+			continue;
 
-		if (str[0] == '#')  // comment
+		if (line[0] == '#')  // comment
 			continue;
-		if (str[0] != ':') {
+		if (line[0] != ':') {
 			printError("Error: a line must start with ':'");
 			return EXIT_FAILURE;
 		}
-		/* len */
-		sscanf((char *)&str[LEN_BASE], "%2hx", &byteLen);
-		/* address */
-		sscanf((char *)&str[ADDR_BASE], "%4x", &addr);
-		/* type */
-		sscanf((char *)&str[TYPE_BASE], "%2hx", &type);
-		/* checksum */
-		sscanf((char *)&str[DATA_BASE + byteLen * 2], "%2hx", &checksum);
-
-		sum = byteLen + type + (addr & 0xff) + ((addr >> 8) & 0xff);
+		if (!decodeHexRecord(line, len, rec)) {
+			printError("Error: malformed record or wrong checksum");
+			return EXIT_FAILURE;
+		}
 
-		switch (type) {
+		uint32_t loc_addr;
+		switch (rec.type) {
 		case 0:
-			loc_addr = _base_addr + addr;
+			loc_addr = _base_addr + rec.addr;
 			/* if this is the first line
 			 * prepare structure with base address
 			 * if previous address + line length didn't match new addr
 			 * -> break -> store and start a new section
 			 */
-			if (next_addr != addr || is_first) {
+			if (next_addr != rec.addr || is_first) {
 				if (!is_first)
 					_array_content.push_back(cnt);
 				cnt.addr = loc_addr;
@@ -94,32 +79,27 @@ int IhexParser::parse()
 				is_first = false;
 			}
 
-			ptr = (char *)&str[DATA_BASE];
-			for (int i = 0; i < byteLen; i++, ptr += 2) {
-				sscanf(ptr, "%2hx", &tmp);
-				_bit_data[loc_addr + i] = (_reverseOrder)? reverseByte(tmp):tmp;
-				sum += tmp;
-				cnt.line_data.push_back(_bit_data[loc_addr+i]);
+			storeData(loc_addr, rec.data, rec.len, _reverseOrder);
+			if (rec.len != 0) {
+				const uint8_t *data = (const uint8_t *)&_bit_data[loc_addr];
+				cnt.line_data.insert(cnt.line_data.end(), data,
+					data + rec.len);
 			}
-			cnt.length += byteLen;
-			next_addr = addr + byteLen;
-			_bit_length += (byteLen * 8);
+			cnt.length += rec.len;
+			next_addr = rec.addr + rec.len;
 			break;
 		case 1:
 			if (cnt.length != 0)
 				_array_content.push_back(cnt);
+			closeSegments();
 			return EXIT_SUCCESS;
 			break;
 		default:
 			printError("Error: unknown type");
 			return EXIT_FAILURE;
 		}
-
-		if (checksum != (0xff&((~sum)+1))) {
-			printError("Error: wrong checksum");
-			return EXIT_FAILURE;
-		}
 	}
 
+	closeSegments();
 	return EXIT_SUCCESS;
 }
@@ -31,13 +31,14 @@
 
 using namespace std;
 
-JedParser::JedParser(string filename, bool verbose):
+JedParser::JedParser(string filename, bool verbose, bool keep_fuselist):
 	ConfigBitstreamParser(filename, ConfigBitstreamParser::BIN_MODE, verbose),
 	_fuse_count(0), _pin_count(0), _max_vect_test(0),
 	_featuresRow(0), _feabits(0), _has_feabits(false), _checksum(0),
 	_compute_checksum(0),
 	_userCode(0), _security_settings(0), _default_fuse_state(0),
-	_default_test_condition(0), _arch_code(0), _pinout_code(0)
+	_default_test_condition(0), _arch_code(0), _pinout_code(0),
+	_ck_acc(0), _ck_bits(0), _keep_fuselist(keep_fuselist)
 {
 }
 
@@ -80,46 +81,61 @@ vector<string> JedParser::readJEDLine()
 	return lines;
 }
 
-/* convert one serie ASCII 1/0 to a vector of
- * unsigned char
+void JedParser::checksum_add(const uint8_t *packed, size_t len)
+{
+	size_t i = 0;
+	/* Byte aligned stream: packed Byte are directly summed */
+	if (_ck_bits == 0) {
+		for (; i + 8 <= len; i += 8)
+			_compute_checksum += packed[i / 8];
+	}
+	for (; i < len; i += 8) {
+		const int nb = (len - i < 8) ? len - i : 8;
+		_ck_acc |= (uint32_t)packed[i / 8] << _ck_bits;
+		_ck_bits += nb;
+		if (_ck_bits >= 8) {
+			_compute_checksum += _ck_acc & 0xff;
+			_ck_acc >>= 8;
+			_ck_bits -= 8;
+		}
+	}
+}
+
+/* convert one serie ASCII 1/0 to a new row (LSB first)
  */
 void JedParser::buildDataArray(const string &content, struct jed_data &jed)
 {
 	size_t data_len = content.size();
-	string tmp_buff;
-	fuselist += content;
-	for (size_t i = 0; i < content.size(); i+=8) {
-		uint8_t data = 0;
-		for (int ii = 0; ii < 8; ii++) {
-			uint8_t val = (content[i+ii] == '1'?1:0);
-			data |= val << ii;
-		}
-		tmp_buff += data;
-	}
-	jed.data.push_back(std::move(tmp_buff));
+	jed_rows &rows = jed.data;
+	const size_t pos = rows.data.size();
+
+	if (_keep_fuselist)
+		fuselist += content;
+	rows.data.resize(pos + (data_len + 7) / 8);
+	packAsciiBits(content.c_str(), data_len, &rows.data[pos]);
+	rows.row_offset.push_back(rows.data.size());
+	checksum_add(&rows.data[pos], data_len);
 	jed.len += data_len;
 }
 
-/* convert one serie ASCII 1/0 to a vector of
- * unsigned char
- * string must be up to 8 bits
+/* convert one serie ASCII 1/0 to a new row (LSB first)
+ * each string must be up to 8 bits and is stored in one Byte
  */
 void JedParser::buildDataArray(const vector<string> &content,
 		struct jed_data &jed)
 {
 	size_t data_len = 0;
-	string tmp_buff;
+	jed_rows &rows = jed.data;
 	for (size_t i = 0; i < content.size(); i++) {
-		uint8_t data = 0;
+		uint8_t data;
 		data_len += content[i].size();
-		fuselist += content[i];
-		for (size_t ii = 0; ii < content[i].size(); ii++) {
-			uint8_t val = (content[i][ii] == '1'?1:0);
-			data |= val << ii;
-		}
-		tmp_buff += data;
+		if (_keep_fuselist)
+			fuselist += content[i];
+		packAsciiBits(content[i].c_str(), content[i].size(), &data);
+		checksum_add(&data, content[i].size());
+		rows.data.push_back(data);
 	}
-	jed.data.push_back(std::move(tmp_buff));
+	rows.row_offset.push_back(rows.data.size());
 	jed.len += data_len;
 }
 
@@ -170,9 +186,8 @@ void JedParser::displayHeader()
 	for (size_t i = 0; i < _data_list.size(); i++) {
 		printf("area[%zd] %4d %4d ", i, _data_list[i].offset, _data_list[i].len);
 		printf("%zu ", _data_list[i].data.size());
-		for (size_t ii = 0; ii < _data_list[i].data.size(); ii++)
-			for (size_t iii = 0; iii < _data_list[i].data[ii].size(); iii++)
-				printf("%02x", (uint8_t)_data_list[i].data[ii][iii]);
+		for (size_t ii = 0; ii < _data_list[i].data.data.size(); ii++)
+			printf("%02x", _data_list[i].data.data[ii]);
 		printf(" %s\n", _data_list[i].associatedPrevNote.c_str());
 		if (_data_list[i].offset == 2656)
 			break;
@@ -354,19 +369,13 @@ int JedParser::parse()
 		size += _data_list[area].len;
 	}
 
-	std::string fuses;
-	std::copy(fuselist.begin(), fuselist.end(), std::back_inserter(fuses));
-
-	if (fuses.size() % 8) {
-		int diff = (((fuses.size() / 8) + 1) * 8) - fuses.size();
-		for (int i = 0; i < diff; i++)
-			fuses += '0';
+	/* last fuses: padded with 0 */
+	if (_ck_bits != 0) {
+		_compute_checksum += _ck_acc & 0xff;
+		_ck_acc = 0;
+		_ck_bits = 0;
 	}
 
-	for (size_t i = 0; i < fuses.size(); i+=8)
-		_compute_checksum += reverseByte(std::stoi(fuses.substr(i, 8),
-				nullptr, 2));
-
 	if (_verbose)
 		printf("theorical checksum %x -> %x\n", _checksum, _compute_checksum);
 	if (_checksum != _compute_checksum) {
@@ -16,25 +16,52 @@
 #include "configBitstreamParser.hpp"
 
 class JedParser: public ConfigBitstreamParser {
+	public:
+		/*!
+		 * \brief rows of one section: fuses packed LSB first in one
+		 *        buffer, row i is data[row_offset[i]] to
+		 *        data[row_offset[i + 1]] (excluded)
+		 */
+		struct jed_rows {
+			std::vector<uint8_t> data;
+			std::vector<uint32_t> row_offset{0};
+			/* number of rows */
+			size_t size() const { return row_offset.size() - 1; }
+			const uint8_t *row(size_t i) const { return &data[row_offset[i]]; }
+			size_t row_size(size_t i) const {
+				return row_offset[i + 1] - row_offset[i];
+			}
+		};
+
 	private:
 		struct jed_data {
 			int offset;
-			std::vector<std::string> data;
+			jed_rows data;
 			int len;
 			std::string associatedPrevNote;
 		};
 
 	public:
-		JedParser(std::string filename, bool verbose = false);
+		/*!
+		 * \brief constructor
+		 * \param[in] filename: jed file
+		 * \param[in] verbose: verbose mode
+		 * \param[in] keep_fuselist: keep ASCII fuses list (get_fuselist)
+		 */
+		JedParser(std::string filename, bool verbose = false,
+			bool keep_fuselist = false);
 		int parse() override;
 		void displayHeader() override;
 
 		size_t nb_section() { return _data_list.size();}
 		size_t offset_for_section(int id) {return _data_list[id].offset;}
 		int len_for_section(int id) {return _data_list[id].len;}
-		std::string get_fuselist() {return fuselist;}
+		/*!
+		 * \brief ASCII fuses list (only filled with keep_fuselist)
+		 */
+		const std::string &get_fuselist() {return fuselist;}
 		int get_fuse_count() {return _fuse_count;}
-		std::vector<std::string> data_for_section(int id) {
+		const jed_rows &data_for_section(int id) {
 			return _data_list[id].data;
 		}
 		std::string noteForSection(int id) {return _data_list[id].associatedPrevNote;}
@@ -47,6 +74,11 @@ class JedParser: public ConfigBitstreamParser {
 		void buildDataArray(const std::string &content, struct jed_data &jed);
 		void buildDataArray(const std::vector<std::string> &content,
 				struct jed_data &jed);
+		/*!
+		 * \brief append len fuses (packed LSB first) to checksum: fuses
+		 *        stream is summed by Byte regardless of rows boundaries
+		 */
+		void checksum_add(const uint8_t *packed, size_t len);
 		void parseEField(const std::vector<std::string> &content);
 		void parseLField(const std::vector<std::string> &content);
 
@@ -66,6 +98,9 @@ class JedParser: public ConfigBitstreamParser {
 		int _default_test_condition;
 		int _arch_code;
 		int _pinout_code;
+		uint32_t _ck_acc;   /**< fuses not yet added to checksum */
+		int _ck_bits;       /**< number of fuses in _ck_acc */
+		bool _keep_fuselist;
 		std::string fuselist;
 };
 
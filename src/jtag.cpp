@@ -5,6 +5,7 @@
 
 #include <libusb.h>
 
+#include <climits>
 #include <iostream>
 #include <map>
 #include <vector>
@@ -14,6 +15,7 @@
 
 #include "anlogicCable.hpp"
 #include "ch552_jtag.hpp"
+#include "configBitstreamParser.hpp"
 #include "display.hpp"
 #include "jtag.hpp"
 #include "ftdipp_mpsse.hpp"
@@ -61,15 +63,75 @@ using namespace std;
  *           - envoyer le dernier avec 0x4B ou 0x6B
  */
 
+/* shortest TMS path between two TAP states: tms_paths[from][to]
+ * tms: bits to send (LSB first), len: number of bits
+ */
+typedef struct {
+	uint8_t tms;
+	uint8_t len;
+} tms_path_t;
+
+static constexpr tms_path_t tms_paths[16][16] = {
+	/* from TEST_LOGIC_RESET */
+	{{0x00, 0}, {0x00, 1}, {0x02, 2}, {0x02, 3}, {0x02, 4}, {0x0a, 4}, {0x0a, 5}, {0x2a, 6},
+	 {0x1a, 5}, {0x06, 3}, {0x06, 4}, {0x06, 5}, {0x16, 5}, {0x16, 6}, {0x56, 7}, {0x36, 6}},
+	/* from RUN_TEST_IDLE */
+	{{0x07, 3}, {0x00, 0}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5},
+	 {0x0d, 4}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x1b, 5}},
+	/* from SELECT_DR_SCAN */
+	{{0x03, 2}, {0x03, 3}, {0x00, 0}, {0x00, 1}, {0x00, 2}, {0x02, 2}, {0x02, 3}, {0x0a, 4},
+	 {0x06, 3}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5}, {0x0d, 4}},
+	/* from CAPTURE_DR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x00, 0}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x05, 3},
+	 {0x03, 2}, {0x0f, 4}, {0x0f, 5}, {0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* from SHIFT_DR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x00, 0}, {0x01, 1}, {0x01, 2}, {0x05, 3},
+	 {0x03, 2}, {0x0f, 4}, {0x0f, 5}, {0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* from EXIT1_DR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x02, 3}, {0x00, 0}, {0x00, 1}, {0x02, 2},
+	 {0x01, 1}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7}, {0x37, 6}},
+	/* from PAUSE_DR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x01, 2}, {0x05, 3}, {0x00, 0}, {0x01, 1},
+	 {0x03, 2}, {0x0f, 4}, {0x0f, 5}, {0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* from EXIT2_DR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x00, 1}, {0x02, 2}, {0x02, 3}, {0x00, 0},
+	 {0x01, 1}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7}, {0x37, 6}},
+	/* from UPDATE_DR */
+	{{0x07, 3}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5},
+	 {0x00, 0}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x1b, 5}},
+	/* from SELECT_IR_SCAN */
+	{{0x01, 1}, {0x01, 2}, {0x05, 3}, {0x05, 4}, {0x05, 5}, {0x15, 5}, {0x15, 6}, {0x55, 7},
+	 {0x35, 6}, {0x00, 0}, {0x00, 1}, {0x00, 2}, {0x02, 2}, {0x02, 3}, {0x0a, 4}, {0x06, 3}},
+	/* from CAPTURE_IR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7},
+	 {0x37, 6}, {0x0f, 4}, {0x00, 0}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x05, 3}, {0x03, 2}},
+	/* from SHIFT_IR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7},
+	 {0x37, 6}, {0x0f, 4}, {0x0f, 5}, {0x00, 0}, {0x01, 1}, {0x01, 2}, {0x05, 3}, {0x03, 2}},
+	/* from EXIT1_IR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6},
+	 {0x1b, 5}, {0x07, 3}, {0x07, 4}, {0x02, 3}, {0x00, 0}, {0x00, 1}, {0x02, 2}, {0x01, 1}},
+	/* from PAUSE_IR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7},
+	 {0x37, 6}, {0x0f, 4}, {0x0f, 5}, {0x01, 2}, {0x05, 3}, {0x00, 0}, {0x01, 1}, {0x03, 2}},
+	/* from EXIT2_IR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6},
+	 {0x1b, 5}, {0x07, 3}, {0x07, 4}, {0x00, 1}, {0x02, 2}, {0x02, 3}, {0x00, 0}, {0x01, 1}},
+	/* from UPDATE_IR */
+	{{0x07, 3}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5},
+	 {0x0d, 4}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x00, 0}}
+};
+
 Jtag::Jtag(cable_t &cable, const jtag_pins_conf_t *pin_conf, string dev,
 			const string &serial, uint32_t clkHZ, int8_t verbose,
-			const string &firmware_path):
+			const string &firmware_path, const string &ip_adr, uint32_t port):
 			_verbose(verbose),
 			_state(RUN_TEST_IDLE),
 			_tms_buffer_size(128), _num_tms(0),
-			_board_name("nope"), device_index(0)
+			_board_name("nope"), device_index(0), _deferred_read(false)
 {
-	init_internal(cable, dev, serial, pin_conf, clkHZ, firmware_path);
+	init_internal(cable, dev, serial, pin_conf, clkHZ, firmware_path, ip_adr,
+		port);
 	detectChain(5);
 }
 
@@ -80,7 +142,8 @@ Jtag::~Jtag()
 }
 
 void Jtag::init_internal(cable_t &cable, const string &dev, const string &serial,
-	const jtag_pins_conf_t *pin_conf, uint32_t clkHZ, const string &firmware_path)
+	const jtag_pins_conf_t *pin_conf, uint32_t clkHZ, const string &firmware_path,
+	const string &ip_adr, uint32_t port)
 {
 	switch (cable.type) {
 	case MODE_ANLOGICCABLE:
@@ -113,7 +176,7 @@ void Jtag::init_internal(cable_t &cable, const string &dev, const string &serial
 		_jtag = new PirateJtag(clkHZ, _verbose);
 		break;
 	case MODE_XVC:
-		_jtag = new XvcJtag(clkHZ, _verbose);
+		_jtag = new XvcJtag(ip_adr, port, clkHZ, _verbose);
 		break;
 	default:
 		std::cerr << "Jtag: unknown cable type" << std::endl;
@@ -134,6 +197,7 @@ int Jtag::detectChain(int max_dev)
 	/* cleanup */
 	_devices_list.clear();
 	_irlength_list.clear();
+	update_scan_plan();
 
 	go_test_logic_reset();
 	set_state(SHIFT_DR);
@@ -193,6 +257,7 @@ bool Jtag::insert_first(uint32_t device_id, uint16_t irlength)
 {
 	_devices_list.insert(_devices_list.begin(), device_id);
 	_irlength_list.insert(_irlength_list.begin(), irlength);
+	update_scan_plan();
 
 	return true;
 }
@@ -202,27 +267,24 @@ uint16_t Jtag::device_select(uint16_t index)
 	if (index > (uint16_t) _devices_list.size())
 		return -1;
 	device_index = index;
+	update_scan_plan();
 	return device_index;
 }
 
-void Jtag::setTMS(unsigned char tms)
+void Jtag::setTMS(uint8_t tms, uint8_t len)
 {
-	display("%s %x %d %d\n", __func__, tms, _num_tms, (_num_tms >> 3));
-	if (_num_tms+1 == _tms_buffer_size * 8)
+	display("%s %x %d %d %d\n", __func__, tms, len, _num_tms, (_num_tms >> 3));
+	if (_num_tms + len >= _tms_buffer_size * 8)
 		flushTMS(false);
-	if (tms != 0)
-		_tms_buffer[_num_tms>>3] |= (0x1) << (_num_tms & 0x7);
-	_num_tms++;
+	/* len <= 8: bits are spread on at most two bytes */
+	int offset = _num_tms & 0x07;
+	uint16_t bits = (tms & ((1 << len) - 1)) << offset;
+	_tms_buffer[_num_tms >> 3] |= bits & 0xff;
+	if (offset + len > 8)
+		_tms_buffer[(_num_tms >> 3) + 1] |= bits >> 8;
+	_num_tms += len;
 }
 
-/* reconstruct byte sent to TMS pins
- * - use up to 6 bits
- * -since next bit after length is use to
- *  fix TMS state after sent we copy last bit
- *  to bit after next
- * -bit 7 is TDI state for each clk cycles
- */
-
 int Jtag::flushTMS(bool flush_buffer)
 {
 	int ret = 0;
@@ -231,8 +293,8 @@ int Jtag::flushTMS(bool flush_buffer)
 
 		ret = _jtag->writeTMS(_tms_buffer, _num_tms, flush_buffer);
 
-		/* reset buffer and number of bits */
-		memset(_tms_buffer, 0, _tms_buffer_size);
+		/* reset used part of buffer and number of bits */
+		memset(_tms_buffer, 0, (_num_tms + 7) >> 3);
 		_num_tms = 0;
 	} else if (flush_buffer) {
 		_jtag->flush();
@@ -243,8 +305,7 @@ int Jtag::flushTMS(bool flush_buffer)
 void Jtag::go_test_logic_reset()
 {
 	/* idenpendly to current state 5 clk with TMS high is enough */
-	for (int i = 0; i < 6; i++)
-		setTMS(0x01);
+	setTMS(0x3f, 6);
 	flushTMS(false);
 	_state = TEST_LOGIC_RESET;
 }
@@ -258,6 +319,93 @@ int Jtag::read_write(unsigned char *tdi, unsigned char *tdo, int len, char last)
 	return 0;
 }
 
+int Jtag::read_write_exit(unsigned char *tdi, unsigned char *tdo, int len,
+		int end_state)
+{
+	const tms_path_t &path = tms_paths[_state][end_state];
+	flushTMS(false);
+	/* first bit of the path (TMS high to leave SHIFT_xR) is sent with
+	 * the last TDI bit, converter may merge the remaining ones
+	 */
+	_jtag->writeTDIExit(tdi, tdo, len, path.tms, path.len);
+	_state = end_state;
+	return 0;
+}
+
+void Jtag::queue_begin()
+{
+	_tdo_queue.clear();
+	/* when converter doesn't support deferred read
+	 * queued shifts are simply resolved on the fly
+	 */
+	_deferred_read = _jtag->setDeferredRead(true);
+}
+
+int Jtag::queue_shiftIR(unsigned char *tdi, int irlen, int end_state)
+{
+	/* deque: pointer to previous buffers stay valid */
+	_tdo_queue.emplace_back((irlen + 7) / 8, 0);
+	shiftIR(tdi, _tdo_queue.back().data(), irlen, end_state);
+	return _tdo_queue.size() - 1;
+}
+
+int Jtag::queue_shiftDR(unsigned char *tdi, int drlen, int end_state)
+{
+	_tdo_queue.emplace_back((drlen + 7) / 8, 0);
+	shiftDR(tdi, _tdo_queue.back().data(), drlen, end_state);
+	return _tdo_queue.size() - 1;
+}
+
+int Jtag::queue_flush()
+{
+	flushTMS(false);
+	int ret = _jtag->flush();
+	_jtag->setDeferredRead(false);
+	_deferred_read = false;
+	scan_extract();
+	return (ret < 0) ? -1 : 0;
+}
+
+/* raw rx are captured at queue_flush(): the whole batch is sent in
+ * one stream
+ */
+int Jtag::spi_put_batch(const std::vector<spi_xfer_t> &xfers,
+		std::function<void(const spi_xfer_t &x, uint8_t *rx)> shift_xfer,
+		bool rx_shifted)
+{
+	std::vector<std::vector<uint8_t>> jrx(xfers.size());
+	bool has_rx = false;
+
+	for (auto &x : xfers)
+		has_rx |= x.rx != NULL;
+	if (has_rx)
+		queue_begin();
+
+	for (size_t i = 0; i < xfers.size(); i++) {
+		const spi_xfer_t &x = xfers[i];
+		if (x.rx != NULL)
+			jrx[i].resize(x.len + 3);
+		shift_xfer(x, (x.rx == NULL) ? NULL : jrx[i].data());
+	}
+
+	if (!has_rx)
+		return 0;
+	if (queue_flush() != 0)
+		return -1;
+
+	for (size_t i = 0; i < xfers.size(); i++) {
+		const spi_xfer_t &x = xfers[i];
+		if (x.rx == NULL)
+			continue;
+		if (rx_shifted)
+			ConfigBitstreamParser::reverseShiftedBytes(&jrx[i][1], x.rx,
+				x.len);
+		else
+			ConfigBitstreamParser::reverseBytes(&jrx[i][1], x.rx, x.len);
+	}
+	return 0;
+}
+
 void Jtag::toggleClk(int nb)
 {
 	unsigned char c = (TEST_LOGIC_RESET == _state) ? 1 : 0;
@@ -268,59 +416,141 @@ void Jtag::toggleClk(int nb)
 	return;
 }
 
-int Jtag::shiftDR(unsigned char *tdi, unsigned char *tdo, int drlen, int end_state)
+void Jtag::toggleClk_us(uint32_t us)
 {
-	/* get number of devices in the JTAG chain
-	 * after the selected one
-	 */
-	int bits_after = device_index;
+	uint64_t nb_clk = (uint64_t)us * getClkFreq() / 1000000 + 1;
+	/* toggleClk length is an int */
+	while (nb_clk > 0) {
+		const int nb = (nb_clk > INT_MAX) ? INT_MAX : (int)nb_clk;
+		toggleClk(nb);
+		nb_clk -= nb;
+	}
+}
 
-	/* if current state not shift DR
-	 * move to this state
-	 */
-	if (_state != SHIFT_DR) {
-		set_state(SHIFT_DR);
-		flushTMS(false);  // force transmit tms state
+/* set count bits starting at bit offset off (LSB first) */
+static void set_bits(uint8_t *dst, int off, int count)
+{
+	for (; count > 0 && (off & 0x07); off++, count--)
+		dst[off >> 3] |= 1 << (off & 0x07);
+	memset(dst + (off >> 3), 0xff, count >> 3);
+	off += count & ~0x07;
+	for (count &= 0x07; count > 0; off++, count--)
+		dst[off >> 3] |= 1 << (off & 0x07);
+}
 
-		/* get number of devices, in the JTAG chain,
-		 * before the selected one
-		 */
-		int bits_before = _devices_list.size() - device_index - 1;
+/* or len bits of src at bit offset off of dst (bits must be cleared) */
+static void insert_bits(uint8_t *dst, int off, const uint8_t *src, int len)
+{
+	int nb_byte = (len + 7) >> 3;
+	int sh = off & 0x07;
+	uint8_t *d = dst + (off >> 3);
+	for (int i = 0; i < nb_byte; i++) {
+		uint8_t v = src[i];
+		if (i == nb_byte - 1 && (len & 0x07))
+			v &= (1 << (len & 0x07)) - 1;
+		d[i] |= v << sh;
+		/* remaining bits of v in next byte */
+		if (sh && (i * 8) + (8 - sh) < len)
+			d[i + 1] |= v >> (8 - sh);
+	}
+}
 
-		/* if not 0 send enough bits
-		 */
-		if (bits_before > 0) {
-			int n = (bits_before + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bits_before, 0);
-		}
+/* copy len bits of src starting at bit offset off */
+static void extract_bits(uint8_t *dst, const uint8_t *src, int off, int len)
+{
+	int nb_byte = (len + 7) >> 3;
+	int sh = off & 0x07;
+	int src_bytes = ((off + len + 7) >> 3) - (off >> 3);
+	const uint8_t *s = src + (off >> 3);
+	for (int i = 0; i < nb_byte; i++) {
+		uint8_t v = s[i] >> sh;
+		if (sh && i + 1 < src_bytes)
+			v |= s[i + 1] << (8 - sh);
+		dst[i] = v;
 	}
+	if (len & 0x07)
+		dst[nb_byte - 1] &= (1 << (len & 0x07)) - 1;
+}
 
-	/* write tdi (and read tdo) to the selected device
-	 * end (ie TMS high) is used only when current device
-	 * is the last of the chain and a state change must
-	 * be done
+void Jtag::update_scan_plan()
+{
+	int nb_dev = _devices_list.size();
+	_scan_plan = {0, 0, 0, 0};
+	/* devices before the selected one (in shift order) are the
+	 * last of the list: one bit for DR, irlength for IR
 	 */
-	read_write(tdi, tdo, drlen, bits_after == 0 && end_state != SHIFT_DR);
-
-	/* if it's asked to move in FSM */
-	if (end_state != SHIFT_DR) {
-		/* if current device is not the last */
-		if (bits_after > 0) {
-			int n = (bits_after + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bits_after, 1);  // its the last force
-			                                      // tms high with last bit
+	for (int i = 0; i < nb_dev; i++) {
+		if (i < device_index) {
+			_scan_plan.ir_after += _irlength_list[i];
+			_scan_plan.dr_after++;
+		} else if (i > device_index) {
+			_scan_plan.ir_before += _irlength_list[i];
+			_scan_plan.dr_before++;
 		}
+	}
+}
 
-		/* move to end_state */
-		set_state(end_state);
+int Jtag::shift_chain(unsigned char *tdi, unsigned char *tdo, int len,
+		int before, int after, int shift_state, int end_state)
+{
+	/* bypass bits before selected device are only required
+	 * when entering shift state, and bits after only when leaving it
+	 */
+	if (_state != shift_state)
+		set_state(shift_state);
+	else
+		before = 0;
+	if (end_state == shift_state)
+		after = 0;
+
+	if (before == 0 && after == 0) {
+		if (end_state == shift_state)
+			return read_write(tdi, tdo, len, 0);
+		return read_write_exit(tdi, tdo, len, end_state);
 	}
+
+	/* full chain vector: bypass (1) + payload + bypass (1) */
+	int total = before + len + after;
+	_scan_tx.assign((total + 7) >> 3, 0);
+	set_bits(_scan_tx.data(), 0, before);
+	if (tdi)
+		insert_bits(_scan_tx.data(), before, tdi, len);
+	set_bits(_scan_tx.data(), before + len, after);
+
+	uint8_t *rx = NULL;
+	if (tdo) {
+		_scan_extract.push_back({tdo, std::vector<uint8_t>(_scan_tx.size()),
+			before, len});
+		rx = _scan_extract.back().rx.data();
+	}
+
+	if (end_state == shift_state)
+		read_write(_scan_tx.data(), rx, total, 0);
+	else
+		read_write_exit(_scan_tx.data(), rx, total, end_state);
+
+	/* with deferred read payload is extracted by queue_flush */
+	if (tdo && !_deferred_read)
+		scan_extract();
 	return 0;
 }
 
+void Jtag::scan_extract()
+{
+	for (auto &ext : _scan_extract)
+		extract_bits(ext.tdo, ext.rx.data(), ext.offset, ext.len);
+	_scan_extract.clear();
+}
+
+int Jtag::shiftDR(unsigned char *tdi, unsigned char *tdo, int drlen, int end_state)
+{
+	/* devices before the selected one are in bypass (1 bit each)
+	 * end (ie TMS high) is sent with the last bit of the chain
+	 */
+	return shift_chain(tdi, tdo, drlen, _scan_plan.dr_before,
+		_scan_plan.dr_after, SHIFT_DR, end_state);
+}
+
 int Jtag::shiftIR(unsigned char tdi, int irlen, int end_state)
 {
 	if (irlen > 8) {
@@ -332,251 +562,21 @@ int Jtag::shiftIR(unsigned char tdi, int irlen, int end_state)
 
 int Jtag::shiftIR(unsigned char *tdi, unsigned char *tdo, int irlen, int end_state)
 {
-	display("%s: avant shiftIR\n", __func__);
-	int bypass_after = 0;
-	if (end_state != SHIFT_IR) {
-		/* when the device is not alone and not
-		 * the first a serie of bypass must be
-		 * send to complete send ir sequence
-		 */
-		for (int i = 0; i < device_index; i++)
-			bypass_after += _irlength_list[i];
-	}
-
-	/* if not in SHIFT IR move to this state */
-	if (_state != SHIFT_IR) {
-		set_state(SHIFT_IR);
-		/* force flush */
-		flushTMS(false);
-
-		/* send serie of bypass instructions
-		 * final size depends on number of device
-		 * before targeted and irlength of each one
-		 */
-		int bypass_before = 0;
-		for (unsigned int i = device_index + 1; i < _devices_list.size(); i++)
-			bypass_before += _irlength_list[i];
-
-		/* if > 0 send bits */
-		if (bypass_before > 0) {
-			int n = (bypass_before + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bypass_before, 0);
-		}
-	}
-
-	display("%s: envoi ircode\n", __func__);
-
-	/* write tdi (and read tdo) to the selected device
-	 * end (ie TMS high) is used only when current device
-	 * is the last of the chain and a state change must
-	 * be done
-	 */
-	read_write(tdi, tdo, irlen, bypass_after == 0 && end_state != SHIFT_IR);
-
-	/* it's asked to move out of SHIFT IR state */
-	if (end_state != SHIFT_IR) {
-		/* again if devices after fill '1' */
-		if (bypass_after > 0) {
-			int n = (bypass_after + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bypass_after, 1);
-		}
-		/* move to the requested state */
-		set_state(end_state);
-	}
-
-	return 0;
+	/* others devices receive bypass instruction (all 1) */
+	return shift_chain(tdi, tdo, irlen, _scan_plan.ir_before,
+		_scan_plan.ir_after, SHIFT_IR, end_state);
 }
 
 void Jtag::set_state(int newState)
 {
-	unsigned char tms;
-	while (newState != _state) {
-		display("_state : %16s(%02d) -> %s(%02d) ",
-			getStateName((tapState_t)_state),
-			_state,
-			getStateName((tapState_t)newState), newState);
-		switch (_state) {
-		case TEST_LOGIC_RESET:
-			if (newState == TEST_LOGIC_RESET) {
-				tms = 1;
-			} else {
-				tms = 0;
-				_state = RUN_TEST_IDLE;
-			}
-			break;
-		case RUN_TEST_IDLE:
-			if (newState == RUN_TEST_IDLE) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = SELECT_DR_SCAN;
-			}
-			break;
-		case SELECT_DR_SCAN:
-			switch (newState) {
-			case CAPTURE_DR:
-			case SHIFT_DR:
-			case EXIT1_DR:
-			case PAUSE_DR:
-			case EXIT2_DR:
-			case UPDATE_DR:
-				tms = 0;
-				_state = CAPTURE_DR;
-				break;
-			default:
-				tms = 1;
-				_state = SELECT_IR_SCAN;
-			}
-			break;
-		case SELECT_IR_SCAN:
-			switch (newState) {
-			case CAPTURE_IR:
-			case SHIFT_IR:
-			case EXIT1_IR:
-			case PAUSE_IR:
-			case EXIT2_IR:
-			case UPDATE_IR:
-				tms = 0;
-				_state = CAPTURE_IR;
-				break;
-			default:
-				tms = 1;
-				_state = TEST_LOGIC_RESET;
-			}
-			break;
-			/* DR column */
-		case CAPTURE_DR:
-			if (newState == SHIFT_DR) {
-				tms = 0;
-				_state = SHIFT_DR;
-			} else {
-				tms = 1;
-				_state = EXIT1_DR;
-			}
-			break;
-		case SHIFT_DR:
-			if (newState == SHIFT_DR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT1_DR;
-			}
-			break;
-		case EXIT1_DR:
-			switch (newState) {
-			case PAUSE_DR:
-			case EXIT2_DR:
-			case SHIFT_DR:
-			case EXIT1_DR:
-				tms = 0;
-				_state = PAUSE_DR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_DR;
-			}
-			break;
-		case PAUSE_DR:
-			if (newState == PAUSE_DR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT2_DR;
-			}
-			break;
-		case EXIT2_DR:
-			switch (newState) {
-			case SHIFT_DR:
-			case EXIT1_DR:
-			case PAUSE_DR:
-				tms = 0;
-				_state = SHIFT_DR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_DR;
-			}
-			break;
-		case UPDATE_DR:
-			if (newState == RUN_TEST_IDLE) {
-				tms = 0;
-				_state = RUN_TEST_IDLE;
-			} else {
-				tms = 1;
-				_state = SELECT_DR_SCAN;
-			}
-			break;
-			/* IR column */
-		case CAPTURE_IR:
-			if (newState == SHIFT_IR) {
-				tms = 0;
-				_state = SHIFT_IR;
-			} else {
-				tms = 1;
-				_state = EXIT1_IR;
-			}
-			break;
-		case SHIFT_IR:
-			if (newState == SHIFT_IR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT1_IR;
-			}
-			break;
-		case EXIT1_IR:
-			switch (newState) {
-			case PAUSE_IR:
-			case EXIT2_IR:
-			case SHIFT_IR:
-			case EXIT1_IR:
-				tms = 0;
-				_state = PAUSE_IR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_IR;
-			}
-			break;
-		case PAUSE_IR:
-			if (newState == PAUSE_IR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT2_IR;
-			}
-			break;
-		case EXIT2_IR:
-			switch (newState) {
-			case SHIFT_IR:
-			case EXIT1_IR:
-			case PAUSE_IR:
-				tms = 0;
-				_state = SHIFT_IR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_IR;
-			}
-			break;
-		case UPDATE_IR:
-			if (newState == RUN_TEST_IDLE) {
-				tms = 0;
-				_state = RUN_TEST_IDLE;
-			} else {
-				tms = 1;
-				_state = SELECT_DR_SCAN;
-			}
-			break;
-		}
-
-		setTMS(tms);
-		display("%d %d %d %x\n", tms, _num_tms-1, _state,
-			_tms_buffer[(_num_tms-1) / 8]);
+	if (newState != _state) {
+		const tms_path_t &path = tms_paths[_state][newState];
+		display("_state : %16s(%02d) -> %s(%02d) %02x %d\n",
+			getStateName((tapState_t)_state), _state,
+			getStateName((tapState_t)newState), newState,
+			path.tms, path.len);
+		setTMS(path.tms, path.len);
+		_state = newState;
 	}
 	/* force write buffer */
 	flushTMS(false);
@@ -6,6 +6,8 @@
 #ifndef JTAG_H
 #define JTAG_H
 #include <ftdi.h>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -14,12 +16,14 @@
 #include "cable.hpp"
 #include "ftdipp_mpsse.hpp"
 #include "jtagInterface.hpp"
+#include "spiInterface.hpp"
 
 class Jtag {
  public:
 	Jtag(cable_t &cable, const jtag_pins_conf_t *pin_conf, std::string dev,
 		const std::string &serial, uint32_t clkHZ, int8_t verbose = 0,
-		const std::string &firmware_path = "");
+		const std::string &firmware_path = "",
+		const std::string &ip_adr = "127.0.0.1", uint32_t port = 2542);
 	~Jtag();
 
 	/* maybe to update */
@@ -67,13 +71,79 @@ class Jtag {
 	int shiftDR(unsigned char *tdi, unsigned char *tdo, int drlen,
 		int end_state = RUN_TEST_IDLE);
 	int read_write(unsigned char *tdi, unsigned char *tdo, int len, char last);
+	/*!
+	 * \brief send tdi (and read tdo) from SHIFT_xR, last bit is sent with
+	 *        TMS high, then move to end_state
+	 * \param[in] tdi: bits to send
+	 * \param[in] tdo: bits read, may be NULL
+	 * \param[in] len: number of bits
+	 * \param[in] end_state: state to reach after shift
+	 */
+	int read_write_exit(unsigned char *tdi, unsigned char *tdo, int len,
+		int end_state);
+
+	/*!
+	 * \brief start a batch of queued transactions: until queue_flush()
+	 *        TDO are not read back immediately (when converter is able
+	 *        to defer read), including tdo buffers given to shiftIR/shiftDR
+	 *        which must stay valid until queue_flush()
+	 */
+	void queue_begin();
+	/*!
+	 * \brief queue a shiftIR with TDO capture
+	 * \return handle to use with queue_tdo
+	 */
+	int queue_shiftIR(unsigned char *tdi, int irlen,
+		int end_state = RUN_TEST_IDLE);
+	/*!
+	 * \brief queue a shiftDR with TDO capture
+	 * \return handle to use with queue_tdo
+	 */
+	int queue_shiftDR(unsigned char *tdi, int drlen,
+		int end_state = RUN_TEST_IDLE);
+	/*!
+	 * \brief send all queued transactions and resolve TDO in one batch
+	 * \return -1 when transfer fails, 0 otherwise
+	 */
+	int queue_flush();
+	/*!
+	 * \brief TDO bits captured by a queued shift
+	 * \param[in] handle: value returned by queue_shiftIR/queue_shiftDR
+	 * \return TDO buffer, valid after queue_flush() and until next
+	 *         queue_begin()
+	 */
+	const uint8_t *queue_tdo(int handle) {return _tdo_queue[handle].data();}
+	/*!
+	 * \brief send SPI transactions bridged over JTAG: when at least one
+	 *        transaction reads, the whole list is queued and flushed
+	 *        once, then rx bytes are extracted
+	 * \param[in] xfers: transactions list
+	 * \param[in] shift_xfer: queue one transaction (cmd, tx and JTAG
+	 *            specific frame). rx is NULL or a buffer of xfer len + 3
+	 *            bytes filled with TDO. rx bytes start at rx[1]
+	 * \param[in] rx_shifted: rx is one bit late
+	 * \return -1 when transfer fails, 0 otherwise
+	 */
+	int spi_put_batch(const std::vector<spi_xfer_t> &xfers,
+		std::function<void(const spi_xfer_t &x, uint8_t *rx)> shift_xfer,
+		bool rx_shifted = true);
 
 	void toggleClk(int nb);
+	/*!
+	 * \brief toggle TCK for at least us microseconds
+	 * \param[in] us: delay in microseconds
+	 */
+	void toggleClk_us(uint32_t us);
 	void go_test_logic_reset();
 	void set_state(int newState);
 	int flushTMS(bool flush_buffer = false);
 	void flush() {flushTMS(); _jtag->flush();}
-	void setTMS(unsigned char tms);
+	/*!
+	 * \brief append TMS bits to internal buffer
+	 * \param[in] tms: bits to send (LSB first)
+	 * \param[in] len: number of bits (max 8)
+	 */
+	void setTMS(uint8_t tms, uint8_t len = 1);
 
 	enum tapState_t {
 		TEST_LOGIC_RESET = 0,
@@ -105,7 +175,8 @@ class Jtag {
 	void init_internal(cable_t &cable, const std::string &dev,
 		const std::string &serial,
 		const jtag_pins_conf_t *pin_conf, uint32_t clkHZ,
-		const std::string &firmware_path);
+		const std::string &firmware_path, const std::string &ip_adr,
+		uint32_t port);
 	/*!
 	 * \brief search in fpga_list and misc_dev_list for a device with idcode
 	 *        if found insert idcode and irlength in _devices_list and
@@ -114,6 +185,27 @@ class Jtag {
 	 * \return false if not found, true otherwise
 	 */
 	bool search_and_insert_device_with_idcode(uint32_t idcode);
+	/*!
+	 * \brief compute bypass bits around selected device
+	 */
+	void update_scan_plan();
+	/*!
+	 * \brief send payload to the selected device as one chain vector
+	 *        (with bypass bits before and after)
+	 * \param[in] tdi: payload, may be NULL
+	 * \param[in] tdo: payload read back, may be NULL
+	 * \param[in] len: payload length (bits)
+	 * \param[in] before: bypass bits sent before payload
+	 * \param[in] after: bypass bits sent after payload
+	 * \param[in] shift_state: SHIFT_DR or SHIFT_IR
+	 * \param[in] end_state: state to reach after shift
+	 */
+	int shift_chain(unsigned char *tdi, unsigned char *tdo, int len,
+		int before, int after, int shift_state, int end_state);
+	/*!
+	 * \brief copy payload of chain vectors read back to callers buffers
+	 */
+	void scan_extract();
 	int8_t _verbose;
 	int _state;
 	int _tms_buffer_size;
@@ -124,5 +216,23 @@ class Jtag {
 	int device_index; /*!< index for targeted FPGA */
 	std::vector<int32_t> _devices_list; /*!< ordered list of devices idcode */
 	std::vector<int16_t> _irlength_list; /*!< ordered list of irlength */
+	std::deque<std::vector<uint8_t>> _tdo_queue; /*!< queued shifts TDO */
+	bool _deferred_read; /*!< converter fills tdo at flush time */
+
+	/* bypass bits around selected device, updated by device_select() */
+	struct {
+		int ir_before; /*!< IR bits sent before selected device IR */
+		int ir_after;  /*!< IR bits sent after selected device IR */
+		int dr_before; /*!< DR bits sent before selected device DR */
+		int dr_after;  /*!< DR bits sent after selected device DR */
+	} _scan_plan;
+	std::vector<uint8_t> _scan_tx; /*!< chain vector */
+	typedef struct {
+		uint8_t *tdo;            /*!< caller buffer */
+		std::vector<uint8_t> rx; /*!< chain vector read back */
+		int offset;              /*!< payload offset in rx */
+		int len;                 /*!< payload length */
+	} scan_extract_t;
+	std::deque<scan_extract_t> _scan_extract; /*!< pending payload copies */
 };
 #endif
@@ -42,6 +42,40 @@ class JtagInterface {
 	 */
 	virtual int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) = 0;
 
+	/*!
+	 * \brief send TDI bits and leave shift[i|d]r: last bit is sent
+	 *        with the first TMS bit of tms path (always high), remaining
+	 *        TMS bits follow. Converters able to send the full path in the
+	 *        same command should override this method.
+	 * \param tx: array of TDI values (used to write)
+	 * \param rx: array of TDO values (used when read)
+	 * \param len: number of bit to send/receive
+	 * \param tms: TMS path (LSB first)
+	 * \param tms_len: TMS path length (max 8)
+	 * \return writeTDI return value
+	 */
+	virtual int writeTDIExit(uint8_t *tx, uint8_t *rx, uint32_t len,
+		uint8_t tms, uint8_t tms_len)
+	{
+		int ret = writeTDI(tx, rx, len, true);
+		if (ret < 0 || tms_len < 2)
+			return ret;
+		uint8_t tail = tms >> 1;
+		int tms_ret = writeTMS(&tail, tms_len - 1, false);
+		return (tms_ret < 0) ? tms_ret : ret;
+	}
+
+	/*!
+	 * \brief enable/disable deferred read: when enabled rx buffers given
+	 *        to writeTDI are only filled by the next flush(), allowing
+	 *        converter to group many reads in one round trip.
+	 *        Disabling deferred read resolves pending reads.
+	 * \param enable: deferred read state
+	 * \return false when converter doesn't support deferred read (rx
+	 *         buffers are always filled before writeTDI returns)
+	 */
+	virtual bool setDeferredRead(bool enable) { (void)enable; return false; }
+
 	/*!
 	 * \brief toggle clk without touch of TDI/TMS
 	 * \param tms: state of tms signal
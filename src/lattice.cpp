@@ -10,8 +10,10 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include "jtag.hpp"
 #include "lattice.hpp"
@@ -262,7 +264,7 @@ bool Lattice::checkStatus(uint32_t val, uint32_t mask)
 bool Lattice::program_mem()
 {
 	bool err;
-	LatticeBitParser _bit(_filename, _verbose);
+	LatticeBitParser _bit(_filename, _verbose, true);
 
 	printInfo("Open file: ", false);
 	printSuccess("DONE");
@@ -329,7 +331,6 @@ bool Lattice::program_mem()
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
 	_jtag->toggleClk(1000);
 
-	uint8_t *data = _bit.getData();
 	int length = _bit.getLength()/8;
 	wr_rd(0x7A, NULL, 0, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
@@ -349,8 +350,14 @@ bool Lattice::program_mem()
 			next_state = Jtag::RUN_TEST_IDLE;
 		}
 
-		for (int ii = 0; ii < size; ii++)
-			tmp[ii] = ConfigBitstreamParser::reverseByte(data[i+ii]);
+		/* streamed bitstream: decompressed while sent */
+		const uint8_t *data = _bit.nextData(size);
+		if (!data) {
+			progress.fail();
+			printError("Error: fail to read bitstream");
+			return false;
+		}
+		ConfigBitstreamParser::reverseBytes(data, tmp, size);
 
 		_jtag->shiftDR(tmp, NULL, size*8, next_state);
 	}
@@ -400,7 +407,9 @@ bool Lattice::program_intFlash(JedParser& _jed)
 	uint64_t featuresRow;
 	uint16_t feabits;
 	uint8_t eraseMode = 0;
-	vector<string> ufm_data, cfg_data, ebr_data;
+	const JedParser::jed_rows no_data;
+	const JedParser::jed_rows *ufm_data = &no_data, *cfg_data = &no_data,
+		*ebr_data = &no_data;
 
 	/* bypass */
 	wr_rd(0xff, NULL, 0, NULL, 0);
@@ -419,13 +428,13 @@ bool Lattice::program_intFlash(JedParser& _jed)
 		string note = _jed.noteForSection(i);
 		if (note == "TAG DATA") {
 			eraseMode |= FLASH_ERASE_UFM;
-			ufm_data = _jed.data_for_section(i);
+			ufm_data = &_jed.data_for_section(i);
 		} else if (note == "END CONFIG DATA") {
 			continue;
 		} else if (note == "EBR_INIT DATA") {
-			ebr_data = _jed.data_for_section(i);
+			ebr_data = &_jed.data_for_section(i);
 		} else {
-			cfg_data = _jed.data_for_section(i);
+			cfg_data = &_jed.data_for_section(i);
 		}
 	}
 
@@ -451,17 +460,17 @@ bool Lattice::program_intFlash(JedParser& _jed)
 	_jtag->toggleClk(1000);
 
 	/* flash CfgFlash */
-	if (false == flashProg(0, "data", cfg_data))
+	if (false == flashProg(0, "data", *cfg_data))
 		return false;
 
 	/* flash EBR Init */
-	if (ebr_data.size()) {
-		if (false == flashProg(0, "EBR", ebr_data))
+	if (ebr_data->size()) {
+		if (false == flashProg(0, "EBR", *ebr_data))
 			return false;
 	}
 	/* verify write */
 	if (_verify) {
-		if (Verify(cfg_data) == false)
+		if (Verify(*cfg_data) == false)
 			return false;
 	}
 
@@ -631,8 +640,7 @@ bool Lattice::program_extFlash(unsigned int offset, bool unprotect_flash)
 		}
 	}
 
-	ret = SPIInterface::write(offset, _bit->getData(), _bit->getLength() / 8,
-			unprotect_flash);
+	ret = SPIInterface::write(offset, _bit, unprotect_flash);
 
 	delete _bit;
 	return ret;
@@ -1045,12 +1053,13 @@ bool Lattice::flashErase(uint32_t  mask)
 	return true;
 }
 
-bool Lattice::flashProg(uint32_t start_addr, const string &name, vector<string> data)
+bool Lattice::flashProg(uint32_t start_addr, const string &name,
+		const JedParser::jed_rows &data)
 {
 	(void)start_addr;
 	ProgressBar progress("Writing " + name, data.size(), 50, _quiet);
 	for (uint32_t line = 0; line < data.size(); line++) {
-		wr_rd(PROG_CFG_FLASH, (uint8_t *)data[line].c_str(),
+		wr_rd(PROG_CFG_FLASH, (uint8_t *)data.row(line),
 				16, NULL, 0);
 		_jtag->set_state(Jtag::RUN_TEST_IDLE);
 		_jtag->toggleClk(1000);
@@ -1062,9 +1071,10 @@ bool Lattice::flashProg(uint32_t start_addr, const string &name, vector<string>
 	return true;
 }
 
-bool Lattice::Verify(std::vector<std::string> data, bool unlock, uint32_t flash_area)
+bool Lattice::Verify(const JedParser::jed_rows &data, bool unlock,
+		uint32_t flash_area)
 {
-	uint8_t tx_buf[16], rx_buf[16];
+	uint8_t tx_buf[16];
 	if (unlock)
 		EnableISC(0x08);
 
@@ -1087,22 +1097,37 @@ bool Lattice::Verify(std::vector<std::string> data, bool unlock, uint32_t flash_
 	memset(tx_buf, 0, 16);
 	bool failure = false;
 	ProgressBar progress("Verifying", data.size(), 50, _quiet);
-	for (size_t line = 0;  line< data.size(); line++) {
-		_jtag->set_state(Jtag::RUN_TEST_IDLE);
-		_jtag->toggleClk(2);
-		_jtag->shiftDR(tx_buf, rx_buf, 16*8, Jtag::PAUSE_DR);
-		for (size_t i = 0; i < data[line].size(); i++) {
-			if (rx_buf[i] != (unsigned char)data[line][i]) {
-				printf("%3zu %3zu %02x -> %02x\n", line, i,
-						rx_buf[i], (unsigned char)data[line][i]);
-				failure = true;
+	/* rows are read by batches: one round trip per batch */
+	const size_t batch_size = 64;
+	int handles[batch_size];
+	for (size_t line = 0; line < data.size(); line += batch_size) {
+		size_t nb_lines = std::min(batch_size, data.size() - line);
+		_jtag->queue_begin();
+		for (size_t l = 0; l < nb_lines; l++) {
+			_jtag->set_state(Jtag::RUN_TEST_IDLE);
+			_jtag->toggleClk(2);
+			handles[l] = _jtag->queue_shiftDR(tx_buf, 16*8, Jtag::PAUSE_DR);
+		}
+		if (_jtag->queue_flush() < 0) {
+			failure = true;
+			break;
+		}
+		for (size_t l = 0; l < nb_lines && !failure; l++) {
+			const uint8_t *rx_buf = _jtag->queue_tdo(handles[l]);
+			const uint8_t *row = data.row(line + l);
+			for (size_t i = 0; i < data.row_size(line + l); i++) {
+				if (rx_buf[i] != row[i]) {
+					printf("%3zu %3zu %02x -> %02x\n", line + l, i,
+							rx_buf[i], row[i]);
+					failure = true;
+				}
 			}
 		}
 		if (failure) {
 			printf("Verify Failure\n");
 			break;
 		}
-		progress.display(line);
+		progress.display(line + nb_lines - 1);
 	}
 	if (unlock)
 		DisableISC();
@@ -1197,28 +1222,27 @@ bool Lattice::loadConfiguration()
 
 int Lattice::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	int xfer_len = len + 1;
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
+	return spi_put_batch({{cmd, tx, rx, len}});
+}
 
-	jtx[0] = LatticeBitParser::reverseByte(cmd);
+int Lattice::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	return _jtag->spi_put_batch(xfers,
+		[&](const spi_xfer_t &x, uint8_t *rx) {
+			int xfer_len = x.len + 1;
+			std::vector<uint8_t> jtx(xfer_len);
 
-	if (tx) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i+1] = LatticeBitParser::reverseByte(tx[i]);
-	}
+			jtx[0] = LatticeBitParser::reverseByte(x.cmd);
 
-	/* send first already stored cmd,
-	 * in the same time store each byte
-	 * to next
-	 */
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
+			if (x.tx)
+				LatticeBitParser::reverseBytes(x.tx, &jtx[1], x.len);
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = LatticeBitParser::reverseByte(jrx[i+1]);
-	}
-	return 0;
+			/* send first already stored cmd,
+			 * in the same time store each byte
+			 * to next
+			 */
+			_jtag->shiftDR(jtx.data(), rx, 8*xfer_len);
+		}, false);
 }
 
 int Lattice::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
@@ -1227,10 +1251,8 @@ int Lattice::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	uint8_t jtx[xfer_len];
 	uint8_t jrx[xfer_len];
 
-	if (tx) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i] = LatticeBitParser::reverseByte(tx[i]);
-	}
+	if (tx)
+		LatticeBitParser::reverseBytes(tx, jtx, len);
 
 	/* send first already stored cmd,
 	 * in the same time store each byte
@@ -1238,13 +1260,18 @@ int Lattice::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	 */
 	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = LatticeBitParser::reverseByte(jrx[i]);
-	}
+	if (rx != NULL)
+		LatticeBitParser::reverseBytes(jrx, rx, len);
 	return 0;
 }
 
+/* flash works while JTAG stays in idle: clocks are only sent */
+bool Lattice::spi_delay(uint32_t us)
+{
+	_jtag->toggleClk_us(us);
+	return true;
+}
+
 int Lattice::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 		uint32_t timeout, bool verbose)
 {
@@ -1621,7 +1648,6 @@ bool Lattice::program_fea_MachXO3D()
 bool Lattice::program_intFlash_MachXO3D(JedParser& _jed)
 {
 	uint32_t erase_op = 0, prog_op = 0;
-	vector<string> data;
 	int offset, fuse_count;
 
 	/* bypass */
@@ -1642,7 +1668,7 @@ bool Lattice::program_intFlash_MachXO3D(JedParser& _jed)
 	for (size_t i = 0; i < _jed.nb_section(); i++) {
 		std::string area_name;
 
-		data = _jed.data_for_section(i);
+		const JedParser::jed_rows &data = _jed.data_for_section(i);
 		if (data.size() < 1) {
 			/* if no data, nothing to do */
 			continue;
@@ -29,7 +29,7 @@ class Lattice: public Device, SPIInterface {
 		void program(unsigned int offset, bool unprotect_flash) override;
 		bool program_mem();
 		bool program_flash(unsigned int offset, bool unprotect_flash);
-		bool Verify(std::vector<std::string> data, bool unlock = false,
+		bool Verify(const JedParser::jed_rows &data, bool unlock = false,
 				uint32_t flash_area = 0);
 		bool dumpFlash(uint32_t base_addr, uint32_t len) override {
 			return SPIInterface::dump(base_addr, len);
@@ -47,13 +47,18 @@ class Lattice: public Device, SPIInterface {
 		bool unprotect_flash() override {
 			return SPIInterface::unprotect_flash();
 		}
+		void set_flash_mode(bool diff_prog, bool blind_prog) override {
+			SPIInterface::set_flash_mode(diff_prog, blind_prog);
+		}
 
 		/* spi interface */
 		int spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx,
 		uint32_t len) override;
 		int spi_put(uint8_t *tx, uint8_t *rx, uint32_t len) override;
+		int spi_put_batch(const std::vector<spi_xfer_t> &xfers) override;
 		int spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 				uint32_t timeout, bool verbose = false) override;
+		bool spi_delay(uint32_t us) override;
 
 	private:
 		enum lattice_family_t {
@@ -93,7 +98,7 @@ class Lattice: public Device, SPIInterface {
 		bool flashEraseAll();
 		bool flashErase(uint32_t mask);
 		bool flashProg(uint32_t start_addr, const std::string &name,
-				std::vector<std::string> data);
+				const JedParser::jed_rows &data);
 		bool checkStatus(uint32_t val, uint32_t mask);
 		void displayReadReg(uint32_t dev);
 		uint32_t readStatusReg();
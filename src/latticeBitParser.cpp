@@ -20,8 +20,10 @@
 
 using namespace std;
 
-LatticeBitParser::LatticeBitParser(const string &filename, bool verbose):
-	ConfigBitstreamParser(filename, ConfigBitstreamParser::BIN_MODE, verbose),
+LatticeBitParser::LatticeBitParser(const string &filename, bool verbose,
+	bool stream):
+	ConfigBitstreamParser(filename, (stream) ? ConfigBitstreamParser::STREAM_MODE :
+	ConfigBitstreamParser::MMAP_MODE, verbose),
 	_endHeader(0)
 {}
 
@@ -36,31 +38,36 @@ int LatticeBitParser::parseHeader()
 	/* check header signature */
 
 	/* radiant .bit start with LSCC */
-	if (_raw_data[0] == 'L') {
-		if (_raw_data.substr(0, 4) != "LSCC") {
-			printf("Wrong File %s\n", _raw_data.substr(0, 4).c_str());
+	if (_raw_len > 0 && _raw_ptr[0] == 'L') {
+		if (_raw_len < 4 || string(_raw_ptr, 4) != "LSCC") {
+			printf("Wrong File %s\n", string(_raw_ptr,
+				(_raw_len < 4) ? _raw_len : 4).c_str());
 			return EXIT_FAILURE;
 		}
 		currPos += 4;
 	}
 
 	/* bit file comment area start with 0xff00 */
-	if ((uint8_t)_raw_data[currPos] != 0xff || (uint8_t)_raw_data[currPos + 1] != 0x00) {
-		printf("Wrong File %02x%02x\n", (uint8_t) _raw_data[currPos],
-			(uint8_t)_raw_data[currPos]);
+	if ((uint8_t)_raw_ptr[currPos] != 0xff || (uint8_t)_raw_ptr[currPos + 1] != 0x00) {
+		printf("Wrong File %02x%02x\n", (uint8_t) _raw_ptr[currPos],
+			(uint8_t)_raw_ptr[currPos]);
 		return EXIT_FAILURE;
 	}
 	currPos+=2;
 
 
-	_endHeader = _raw_data.find(0xff, currPos);
-	if (_endHeader == string::npos) {
+	const char *end = NULL;
+	if (_raw_len > (size_t)currPos)
+		end = (const char *)memchr(&_raw_ptr[currPos], 0xff,
+				_raw_len - currPos);
+	if (!end) {
 		printError("Error: preamble not found\n");
 		return EXIT_FAILURE;
 	}
+	_endHeader = end - _raw_ptr;
 
 	/* parse header */
-	istringstream lineStream(_raw_data.substr(currPos, _endHeader-currPos));
+	istringstream lineStream(string(&_raw_ptr[currPos], _endHeader-currPos));
 	string buff;
 	while (std::getline(lineStream, buff, '\0')) {
 		size_t pos = buff.find_first_of(':', 0);
@@ -82,25 +89,25 @@ int LatticeBitParser::parse()
 		return EXIT_FAILURE;
 
 	/* check preamble */
-	if ((*(uint32_t *)&_raw_data[_endHeader+1]) != 0xb3bdffff) {
+	if ((*(const uint32_t *)&_raw_ptr[_endHeader+1]) != 0xb3bdffff) {
 		printError("Error: missing preamble\n");
 		return EXIT_FAILURE;
 	}
 
-	/* read All data */
-	_bit_data.resize(_raw_data.size() - _endHeader);
-	std::move(_raw_data.begin()+_endHeader, _raw_data.end(), _bit_data.begin());
-	_bit_length = _bit_data.size() * 8;
+	/* All data: file content used in place (and streamed part) */
+	_payload = (uint8_t *)&_raw_ptr[_endHeader];
+	const size_t len = _raw_len - _endHeader;
+	_bit_length = (len + _stream_len) * 8;
 
 	/* extract idcode from configuration data (area starting with 0xE2) */
-	for (size_t i = 0; i < _bit_data.size();i++) {
-		if ((uint8_t)_bit_data[i] != 0xe2)
+	for (size_t i = 0; i + 8 <= len; i++) {
+		if (_payload[i] != 0xe2)
 			continue;
 		/* E2: verif id */
-		uint32_t idcode = (((uint32_t)_bit_data[i+4]) << 24) |
-						(((uint32_t)_bit_data[i+5]) << 16) |
-						(((uint32_t)_bit_data[i+6]) <<  8) |
-						(((uint32_t)_bit_data[i+7]) <<  0);
+		uint32_t idcode = (((uint32_t)_payload[i+4]) << 24) |
+						(((uint32_t)_payload[i+5]) << 16) |
+						(((uint32_t)_payload[i+6]) <<  8) |
+						(((uint32_t)_payload[i+7]) <<  0);
 		_hdr["idcode"] = string(8, ' ');
 		snprintf(&_hdr["idcode"][0], 9, "%08x", idcode);
 		break;
@@ -14,7 +14,15 @@
 
 class LatticeBitParser: public ConfigBitstreamParser {
 	public:
-		LatticeBitParser(const std::string &filename, bool verbose = false);
+		/*!
+		 * \brief constructor
+		 * \param[in] filename: bitstream file
+		 * \param[in] verbose: verbose mode
+		 * \param[in] stream: gzip file decompressed while data are
+		 *            consumed with nextData()
+		 */
+		LatticeBitParser(const std::string &filename, bool verbose = false,
+			bool stream = false);
 		~LatticeBitParser();
 		int parse() override;
 
@@ -21,6 +21,7 @@
 #include "dfu.hpp"
 #include "display.hpp"
 #include "efinix.hpp"
+#include "flashSource.hpp"
 #include "ftdispi.hpp"
 #include "gowin.hpp"
 #include "ice40.hpp"
@@ -66,6 +67,10 @@ struct arguments {
 	uint32_t protect_flash;
 	bool unprotect_flash;
 	string flash_sector;
+	string ip_adr;
+	uint32_t port;
+	bool spi_diff_prog;
+	bool spi_blind_prog;
 };
 
 int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *pins_config);
@@ -81,7 +86,8 @@ int main(int argc, char **argv)
 	/* command line args. */
 	struct arguments args = {0, false, false, false, 0, "", "", "-", "", -1,
 			0, "-", false, false, false, false, Device::PRG_NONE, false,
-			false, false, "", "", "", -1, 0, false, -1, 0, 0, 0, false, ""};
+			false, false, "", "", "", -1, 0, false, -1, 0, 0, 0, false, "",
+			"127.0.0.1", 2542, false, false};
 	/* parse arguments */
 	try {
 		if (parse_opt(argc, argv, &args, &pins_config))
@@ -210,6 +216,8 @@ int main(int argc, char **argv)
 			printError("Error: Failed to claim cable");
 			return EXIT_FAILURE;
 		}
+		((SPIInterface *)spi)->set_flash_mode(args.spi_diff_prog,
+			args.spi_blind_prog);
 
 		int spi_ret = EXIT_SUCCESS;
 
@@ -255,8 +263,35 @@ int main(int argc, char **argv)
 			SPIFlash flash((SPIInterface *)spi, args.unprotect_flash, args.verbose);
 			flash.display_status_reg();
 
-			if (args.prg_type != Device::RD_FLASH &&
-					(!args.bit_file.empty() || !args.file_type.empty())) {
+			if (args.prg_type != Device::RD_FLASH && !args.bit_file.empty()) {
+				/* raw file: streamed to the flash */
+				FileFlashSource *src = NULL;
+				printInfo("Open file " + args.bit_file + " ", false);
+				try {
+					src = new FileFlashSource(args.bit_file);
+					printSuccess("DONE");
+				} catch (std::exception &e) {
+					printError("FAIL");
+					delete spi;
+					return EXIT_FAILURE;
+				}
+
+				try {
+					if (flash.erase_and_prog(args.offset, *src) == -1)
+						spi_ret = EXIT_FAILURE;
+				} catch (std::exception &e) {
+					printError("FAIL: " + string(e.what()));
+					spi_ret = EXIT_FAILURE;
+				}
+
+				if (args.verify && spi_ret == EXIT_SUCCESS)
+					if (!flash.verify(args.offset, *src))
+						spi_ret = EXIT_FAILURE;
+
+				delete src;
+			} else if (args.prg_type != Device::RD_FLASH &&
+					!args.file_type.empty()) {
+				/* stdin: must be loaded in memory */
 				printInfo("Open file " + args.bit_file + " ", false);
 				try {
 					bit = new RawParser(args.bit_file, false);
@@ -369,7 +404,8 @@ int main(int argc, char **argv)
 	Jtag *jtag;
 	try {
 		jtag = new Jtag(cable, &pins_config, args.device, args.ftdi_serial,
-				args.freq, args.verbose, args.probe_firmware);
+				args.freq, args.verbose, args.probe_firmware, args.ip_adr,
+				args.port);
 	} catch (std::exception &e) {
 		printError("JTAG init failed with: " + string(e.what()));
 		return EXIT_FAILURE;
@@ -488,6 +524,7 @@ int main(int argc, char **argv)
 		delete(jtag);
 		return EXIT_FAILURE;
 	}
+	fpga->set_flash_mode(args.spi_diff_prog, args.spi_blind_prog);
 
 	if ((!args.bit_file.empty() || !args.file_type.empty())
 			&& args.prg_type != Device::RD_FLASH) {
@@ -606,6 +643,8 @@ int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *p
 				"write bitstream in flash (default: false)")
 			("index-chain",  "device index in JTAG-chain",
 				cxxopts::value<int>(args->index_chain))
+			("ip", "IP address or hostname (only for XVC client)",
+				cxxopts::value<string>(args->ip_adr))
 			("list-boards", "list all supported boards",
 				cxxopts::value<bool>(args->list_boards))
 			("list-cables", "list all supported cables",
@@ -618,6 +657,8 @@ int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *p
 				cxxopts::value<unsigned int>(args->offset))
 			("pins", "pin config (only for ft232R) TDI:TDO:TCK:TMS",
 				cxxopts::value<vector<string>>(pins))
+			("port", "XVC server port (default 2542)",
+				cxxopts::value<uint32_t>(args->port))
 			("probe-firmware", "firmware for JTAG probe (usbBlasterII)",
 				cxxopts::value<string>(args->probe_firmware))
 			("protect-flash",   "protect SPI flash area",
@@ -628,6 +669,12 @@ int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *p
 				cxxopts::value<bool>(args->reset))
 			("spi",   "SPI mode (only for FTDI in serial mode)",
 				cxxopts::value<bool>(args->spi))
+			("spi-blind-prog", "SPI flash: program pages without status "
+				"polling, using max page program time (JTAG bridges)",
+				cxxopts::value<bool>(args->spi_blind_prog))
+			("spi-diff-prog", "SPI flash: read flash first and only "
+				"erase/program modified areas",
+				cxxopts::value<bool>(args->spi_diff_prog))
 			("unprotect-flash",   "Unprotect flash blocks",
 				cxxopts::value<bool>(args->unprotect_flash))
 			("v,verbose", "Produce verbose output", cxxopts::value<bool>(verbose))
@@ -3,7 +3,6 @@
  * Copyright (C) 2019 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 
-#include <sstream>
 #include <string>
 
 #include "configBitstreamParser.hpp"
@@ -12,14 +11,6 @@
 
 using namespace std;
 
-/* line format
- * :LLAAAATTHH...HHCC
- * LL   : nb octets de data dans la ligne (hexa)
- * AAAA : addresse du debut de la ligne ou mettre les data 
- * TT   : type de la ligne (cf. plus bas)
- * HH   : le champ de data
- * CC   : Checksum (cf. plus bas)
- */
 /* type : 00 -> data + addr 16b
  *        01 -> end of file
  *        02 -> extended addr
@@ -28,11 +19,6 @@ using namespace std;
  *        05 -> start linear addr record
  */
 
-#define LEN_BASE  1
-#define ADDR_BASE 3
-#define TYPE_BASE 7
-#define DATA_BASE 9
-
 McsParser::McsParser(const string &filename, bool reverseOrder, bool verbose):
 		ConfigBitstreamParser(filename, ConfigBitstreamParser::ASCII_MODE,
 		verbose),
@@ -41,63 +27,54 @@ McsParser::McsParser(const string &filename, bool reverseOrder, bool verbose):
 
 int McsParser::parse()
 {
-	string str;
-	istringstream lineStream(_raw_data);
+	hex_record_t rec;
+	size_t pos = 0;
 
-	while (std::getline(lineStream, str, '\n')) {
-		char *ptr;
-		uint8_t sum = 0;
-		uint16_t tmp, byteLen, type, checksum;
-		uint32_t addr, loc_addr;
+	while (pos < _raw_data.size()) {
+		const char *line = &_raw_data[pos];
+		size_t end = _raw_data.find('\n', pos);
+		if (end == string::npos)
+			end = _raw_data.size();
+		size_t len = end - pos;
+		pos = end + 1;
 
 		/* if '\r' is present -> drop */
-		if (str.back() == '\r')
-			str.pop_back();
+		if (len > 0 && line[len - 1] == '\r')
+			len--;
+		if (len == 0)
+			continue;
 
-		if (str[0] != ':') {
+		if (line[0] != ':') {
 			printError("Error: a line must start with ':'");
 			return EXIT_FAILURE;
 		}
-		/* len */
-		sscanf((char *)&str[LEN_BASE], "%2hx", &byteLen);
-		/* address */
-		sscanf((char *)&str[ADDR_BASE], "%4x", &addr);
-		/* type */
-		sscanf((char *)&str[TYPE_BASE], "%2hx", &type);
-		/* checksum */
-		sscanf((char *)&str[DATA_BASE + byteLen * 2], "%2hx", &checksum);
-
-		sum = byteLen + type + (addr & 0xff) + ((addr >> 8) & 0xff);
+		if (!decodeHexRecord(line, len, rec)) {
+			printError("Error: malformed record or wrong checksum");
+			return EXIT_FAILURE;
+		}
 
-		switch (type) {
+		switch (rec.type) {
 		case 0:
-			loc_addr = _base_addr + addr;
-			ptr = (char *)&str[DATA_BASE];
-			for (int i = 0; i < byteLen; i++, ptr += 2) {
-				sscanf(ptr, "%2hx", &tmp);
-				_bit_data[loc_addr + i] = (_reverseOrder)? reverseByte(tmp):tmp;
-				sum += tmp;
-			}
-			_bit_length += (byteLen * 8);
+			storeData(_base_addr + rec.addr, rec.data, rec.len,
+				_reverseOrder);
 			break;
 		case 1:
+			closeSegments();
 			return EXIT_SUCCESS;
 			break;
 		case 4:
-			sscanf((char*)&str[DATA_BASE], "%4x", &loc_addr);
-			_base_addr = (loc_addr << 16);
-			sum += (loc_addr & 0xff) + ((loc_addr >> 8) & 0xff);
+			if (rec.len != 2) {
+				printError("Error: wrong extended linear address");
+				return EXIT_FAILURE;
+			}
+			_base_addr = ((rec.data[0] << 8) | rec.data[1]) << 16;
 			break;
 		default:
 			printError("Error: unknown type");
 			return EXIT_FAILURE;
 		}
-
-		if (checksum != (0xff&((~sum)+1))) {
-			printError("Error: wrong checksum");
-			return EXIT_FAILURE;
-		}
 	}
 
+	closeSegments();
 	return EXIT_SUCCESS;
 }
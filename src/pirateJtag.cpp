@@ -37,7 +37,7 @@ using namespace std;
 
 PirateJtag::PirateJtag(uint32_t clkHZ, bool verbose):
 			_verbose(verbose),
-			dev_handle(NULL), usb_ctx(NULL), _curr_tms(0)
+			dev_handle(NULL), usb_ctx(NULL), _usb(NULL), _curr_tms(0)
 {
 	int ret;
 
@@ -62,6 +62,9 @@ PirateJtag::PirateJtag(uint32_t clkHZ, bool verbose):
 		throw std::exception();
 	}
 
+	_usb = new UsbBulkEngine(usb_ctx, dev_handle, PIRATEJTAG_WRITE_EP,
+		PIRATEJTAG_READ_EP, sizeof(_tx_buffer));
+
 	if (setClkFreq(clkHZ) < 0) {
 		cerr << "Fail to set frequency" << endl;
 		throw std::exception();
@@ -70,6 +73,8 @@ PirateJtag::PirateJtag(uint32_t clkHZ, bool verbose):
 
 PirateJtag::~PirateJtag()
 {
+	if (_usb)
+		delete _usb;
 	if (dev_handle)
 		libusb_close(dev_handle);
 	if (usb_ctx)
@@ -164,13 +169,16 @@ int PirateJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 		pos += tx_size;
 	}
 
+	/* rx must be filled before return */
+	if (rx != nullptr && _usb->flush() < 0)
+		return -EXIT_FAILURE;
+
 	return len;
 }
 
 int PirateJtag::write_buffer(uint8_t *tdo)
 {
 	int ret = 0;
-	int actual_length;
 
 	if (_tx_bits == 0)
 		return 0;
@@ -183,29 +191,38 @@ int PirateJtag::write_buffer(uint8_t *tdo)
 	_tx_buffer[1] = ((tx_bytes - 2) >> 8) & 0xff;
 	_tx_buffer[2] = JTAG_CMD_TAP_OUTPUT | (remainder << 4);
 
-	ret = libusb_bulk_transfer(dev_handle, PIRATEJTAG_WRITE_EP,
-							_tx_buffer, tx_bytes, &actual_length, 1000);
-	if (ret < 0 || actual_length != tx_bytes) {
-		cerr << "write: usb bulk write failed " << ret << " len " << actual_length << endl;
-		return -EXIT_FAILURE;
-	}
-	ret = libusb_bulk_transfer(dev_handle, PIRATEJTAG_READ_EP,
-							_rx_buffer, rx_bytes, &actual_length, 1000);
-	if (ret < 0 || actual_length != rx_bytes) {
-		cerr << "write: usb bulk read failed " << ret << " len " << actual_length << endl;
+	/* transfers are only queued: _tx_buffer is copied and may be
+	 * reused immediately. tdo is filled by read completion
+	 */
+	ret = _usb->write(_tx_buffer, tx_bytes);
+	if (ret < 0) {
+		cerr << "write: usb bulk write failed " << ret << endl;
 		return -EXIT_FAILURE;
 	}
-
-	if (tdo != nullptr) {
-		memcpy(tdo, _rx_buffer, rx_bytes);
-
-		if (_verbose) {
-			printf("TDO = ");
-			for (int i = 0; i < _tx_bits; i++) {
-				printf("%d", (tdo[i >> 3] & (1 << (i & 0x07))) != 0);
+	int tx_bits = _tx_bits;
+	bool verbose = _verbose;
+	ret = _usb->read(rx_bytes,
+		[tdo, rx_bytes, tx_bits, verbose](const uint8_t *rx_buf, int rx_len) {
+			if (rx_len != rx_bytes) {
+				cerr << "write: usb bulk read len " << rx_len << endl;
+				return false;
 			}
-			printf("\n");
-		}
+			if (tdo == nullptr)
+				return true;
+			memcpy(tdo, rx_buf, rx_bytes);
+
+			if (verbose) {
+				printf("TDO = ");
+				for (int i = 0; i < tx_bits; i++) {
+					printf("%d", (tdo[i >> 3] & (1 << (i & 0x07))) != 0);
+				}
+				printf("\n");
+			}
+			return true;
+		});
+	if (ret < 0) {
+		cerr << "write: usb bulk read failed " << ret << endl;
+		return -EXIT_FAILURE;
 	}
 
 	ret = _tx_bits;
@@ -9,6 +9,7 @@
 #include <libusb.h>
 
 #include "jtagInterface.hpp"
+#include "usbBulkEngine.hpp"
 
 /*!
  * \file PirateJtag.hpp
@@ -49,9 +50,9 @@ class PirateJtag : public JtagInterface {
 
     libusb_device_handle *dev_handle;
 	libusb_context *usb_ctx;
+	UsbBulkEngine *_usb; /*!< async bulk transfers */
 	uint8_t _curr_tms;
 	uint8_t _tx_buffer[2048];
-	uint8_t _rx_buffer[1023];
 	int _tx_bits;
 };
 #endif  // SRC_PIRATEJTAG_HPP_
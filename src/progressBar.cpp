@@ -12,9 +12,10 @@
 
 ProgressBar::ProgressBar(std::string mess, int maxValue, int progressLen,
 		bool quiet): _mess(mess), _maxValue(maxValue),
-		_progressLen(progressLen), _quiet(quiet), _first(true)
+		_progressLen(progressLen), _show_rate(false), _quiet(quiet), _first(true)
 {
 	last_time = std::chrono::system_clock::now();
+	start_time = last_time;
 }
 void ProgressBar::display(int value, char force)
 {
@@ -46,6 +47,16 @@ void ProgressBar::display(int value, char force)
 	char perc_str[11];
 	snprintf(perc_str, sizeof(perc_str), "] %3.2f%%", percent);
 	printInfo(perc_str, false);
+	if (_show_rate) {
+		std::chrono::duration<double> elapsed = this_time - start_time;
+		char rate_str[32];
+		double rate = (elapsed.count() > 0) ? value / elapsed.count() : 0;
+		if (rate >= 1048576)
+			snprintf(rate_str, sizeof(rate_str), " %.2f MB/s  ", rate / 1048576);
+		else
+			snprintf(rate_str, sizeof(rate_str), " %.2f KB/s  ", rate / 1024);
+		printInfo(rate_str, false);
+	}
 }
 void ProgressBar::done()
 {
@@ -15,12 +15,18 @@ class ProgressBar {
 		void display(int value, char force = 0);
 		void done();
 		void fail();
+		/*!
+		 * \brief append throughput (byte/s) to progress display
+		 */
+		void show_rate() {_show_rate = true;}
 	private:
 		std::string _mess;
 		int _maxValue;
 		int _progressLen;
 		//records the time of last progress bar update
 		std::chrono::time_point<std::chrono::system_clock> last_time;
+		std::chrono::time_point<std::chrono::system_clock> start_time;
+		bool _show_rate;
 		bool _quiet;
 		bool _first;
 };
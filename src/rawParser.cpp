@@ -4,7 +4,6 @@
  */
 
 #include <stdexcept>
-#include <utility>
 
 #include "configBitstreamParser.hpp"
 #include "display.hpp"
@@ -13,20 +12,22 @@
 using namespace std;
 
 RawParser::RawParser(const string &filename, bool reverseOrder):
-		ConfigBitstreamParser(filename, ConfigBitstreamParser::BIN_MODE,
+		ConfigBitstreamParser(filename, ConfigBitstreamParser::MMAP_MODE,
 		false), _reverseOrder(reverseOrder)
 {}
 
 int RawParser::parse()
 {
-	_bit_data.resize(_file_size);
-	std::move(_raw_data.begin(), _raw_data.end(), _bit_data.begin());
-	_bit_length = _bit_data.size();
+	_bit_length = _raw_len;
 
 	if (_reverseOrder) {
-		for (int i = 0; i < _bit_length; i++) {
-			_bit_data[i] = reverseByte(_bit_data[i]);
-		}
+		/* reversed content is stored in _bit_data */
+		_bit_data.resize(_raw_len);
+		reverseBytes((const uint8_t *)_raw_ptr, (uint8_t *)&_bit_data[0],
+			_raw_len);
+	} else {
+		/* file content used in place */
+		_payload = (uint8_t *)_raw_ptr;
 	}
 
 	/* convert size to bit */
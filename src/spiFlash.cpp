@@ -7,10 +7,27 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cmath>
 #include <map>
+#include <condition_variable>
 #include <iostream>
-
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef HAS_ZLIB
+#ifdef HAS_ZLIBNG
+#include <zlib-ng.h>
+#define gzopen(_path, _mode)       zng_gzopen(_path, _mode)
+#define gzwrite(_file, _buf, _len) zng_gzwrite(_file, _buf, _len)
+#define gzclose(_file)             zng_gzclose(_file)
+#else
+#include <zlib.h>
+#endif
+#endif
+
+#include "flashSource.hpp"
 #include "progressBar.hpp"
 #include "display.hpp"
 #include "spiFlash.hpp"
@@ -39,8 +56,13 @@
 #define FLASH_ROTP     0x4B
 /* block (32Kb) erase */
 #define FLASH_BE32     0x52
+/* enter/exit 4-Byte address mode */
+#define FLASH_EN4B     0xB7
+#define FLASH_EX4B     0xE9
 #define FLASH_POWER_UP 0xAB
 #define FLASH_POWER_DOWN 0xB9
+/* read SFDP: 3B addr + 8 dummy */
+#define FLASH_RDSFDP   0x5A
 /* read/write non volatile register: 0B addr + 0 dummy */
 #define FLASH_RDNVCR   0xB5
 #define FLASH_WRNVCR   0xB1
@@ -69,13 +91,121 @@
 
 SPIFlash::SPIFlash(SPIInterface *spi, bool unprotect, int8_t verbose):
 	_spi(spi), _verbose(verbose), _jedec_id(0),
-	_flash_model(NULL), _unprotect(unprotect)
+	_flash_model(NULL), _unprotect(unprotect), _addr_len(3),
+	_addr4_opcodes(false), _addr4_entered(false),
+	_diff_prog(spi->flash_diff_prog()), _blind_prog(spi->flash_blind_prog())
 {
+	init_desc();
 	reset();
 	power_up();
 	read_id();
 }
 
+SPIFlash::~SPIFlash()
+{
+	/* restore 3-Byte mode expected by FPGAs at configuration */
+	exit_addr4();
+}
+
+/* 4-Byte instructions set (used when address mode is not changed) */
+uint8_t SPIFlash::addr_cmd(uint8_t cmd)
+{
+	if (!_addr4_opcodes)
+		return cmd;
+	switch (cmd) {
+	case 0x03:       return 0x13;  /* read */
+	case 0x0B:       return 0x0C;  /* fast read */
+	case 0x3B:       return 0x3C;  /* 1-1-2 read */
+	case 0x6B:       return 0x6C;  /* 1-1-4 read */
+	case FLASH_PP:   return 0x12;
+	case FLASH_SE:   return 0x21;
+	case FLASH_BE32: return 0x5C;
+	case FLASH_BE64: return 0xDC;
+	default:         return cmd;
+	}
+}
+
+int SPIFlash::addr_len(uint32_t end_addr)
+{
+	if (_addr_len == 4 || end_addr <= 0x1000000)
+		return _addr_len;
+
+	/* only EN4B methods are supported (not bank/extended register) */
+	if (!_desc.addr4 || (_desc.addr4_enter & 0x03) == 0) {
+		printError("address beyond 16MB: 4-Byte address mode unsupported");
+		return -1;
+	}
+	if (_desc.addr4_enter & 0x02) {
+		if (write_enable() == -1)
+			return -1;
+	}
+	_spi->spi_put(FLASH_EN4B, NULL, NULL, 0);
+	_addr_len = 4;
+	_addr4_entered = true;
+	return _addr_len;
+}
+
+void SPIFlash::exit_addr4()
+{
+	if (!_addr4_entered)
+		return;
+	if (_desc.addr4_enter & 0x02)
+		write_enable();
+	_spi->spi_put(FLASH_EX4B, NULL, NULL, 0);
+	_addr_len = 3;
+	_addr4_entered = false;
+}
+
+void SPIFlash::init_addr_mode()
+{
+	exit_addr4();
+	_addr_len = 3;
+	_addr4_opcodes = false;
+	if (_desc.addr4_only || (_desc.addr4_enter & 0x40)) {
+		/* always in 4-Byte mode */
+		_addr_len = 4;
+	} else if (_desc.size > 0x1000000 && (_desc.addr4_enter & 0x20)) {
+		/* dedicated instructions: no state change */
+		_addr_len = 4;
+		_addr4_opcodes = true;
+	}
+}
+
+static void put_addr(uint8_t *buf, uint32_t addr, int addr_len)
+{
+	for (int i = 0; i < addr_len; i++)
+		buf[i] = (uint8_t)(0xff & (addr >> (8 * (addr_len - 1 - i))));
+}
+
+int SPIFlash::send_addr_cmd(uint8_t cmd, uint32_t addr)
+{
+	uint8_t tx[4];
+	const int alen = addr_len(addr + 1);
+	if (alen < 0)
+		return -1;
+	put_addr(tx, addr, alen);
+	_spi->spi_put(addr_cmd(cmd), tx, NULL, alen);
+	return 0;
+}
+
+int SPIFlash::write_enabled_cmd(uint8_t cmd, const uint8_t *tx, uint32_t len)
+{
+	uint8_t status = 0;
+	if (_spi->spi_put_batch({
+			{FLASH_WREN, NULL, NULL, 0},
+			{FLASH_RDSR, NULL, &status, 1},
+			{cmd, tx, NULL, len}}) != 0)
+		return -1;
+	/* WEL was not set: cmd has been ignored by the flash */
+	if ((status & FLASH_RDSR_WEL) == 0) {
+		if (write_enable() == -1)
+			return -1;
+		if (_spi->spi_put(cmd, const_cast<uint8_t *>(tx), NULL, len) != 0)
+			return -1;
+	}
+	return 0;
+}
+
 int SPIFlash::bulk_erase()
 {
 	if (write_enable() == -1)
@@ -87,70 +217,84 @@ int SPIFlash::bulk_erase()
 /* sector -> subsector for micron */
 int SPIFlash::sector_erase(int addr)
 {
-	uint8_t tx[4];
-	tx[0] = (uint8_t)(FLASH_SE           );
-	tx[1] = (uint8_t)(0xff & (addr >> 16));
-	tx[2] = (uint8_t)(0xff & (addr >>  8));
-	tx[3] = (uint8_t)(0xff & (addr      ));
-	_spi->spi_put(tx, NULL, 4);
-	return 0;
+	return send_addr_cmd(FLASH_SE, addr);
 }
 
 int SPIFlash::block32_erase(int addr)
 {
-	uint8_t tx[4] = {
-		static_cast<uint8_t>(FLASH_BE32         ),
-		static_cast<uint8_t>(0xff & (addr >> 16)),
-		static_cast<uint8_t>(0xff & (addr >>  8)),
-		static_cast<uint8_t>(0xff & (addr      ))};
-	_spi->spi_put(tx, NULL, 4);
-	return 0;
+	return send_addr_cmd(FLASH_BE32, addr);
 }
 
 /* block64 -> sector for micron */
 int SPIFlash::block64_erase(int addr)
 {
-	uint8_t tx[4] = {
-		static_cast<uint8_t>(FLASH_BE64         ),
-		static_cast<uint8_t>(0xff & (addr >> 16)),
-		static_cast<uint8_t>(0xff & (addr >>  8)),
-		static_cast<uint8_t>(0xff & (addr      ))};
-	_spi->spi_put(tx, NULL, 4);
-	return 0;
+	return send_addr_cmd(FLASH_BE64, addr);
 }
 
+int SPIFlash::erase_area(const flash_erase_t &erase, int addr)
+{
+	uint8_t tx[4];
+	/* 4-Byte mode must be entered before write enable */
+	const int alen = addr_len(addr + erase.size);
+	if (alen < 0)
+		return -1;
+	put_addr(tx, addr, alen);
+	if (write_enabled_cmd(addr_cmd(erase.opcode), tx, alen) == -1)
+		return -1;
+	return _spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00, 100000, false);
+}
+
+/* erase base_addr to base_addr + size using the mix of erase types
+ * with the lowest total (typical) time. Range is rounded to the
+ * smallest erase granularity and never exceeded.
+ */
 int SPIFlash::sectors_erase(int base_addr, int size)
 {
 	int ret = 0;
-	int start_addr = base_addr;
-	/* compute end_addr to be multiple of 4Kb */
-	int end_addr = (base_addr + size + 0xfff) & ~0xfff;
-	ProgressBar progress("Erasing", end_addr, 50, _verbose < 0);
-	/* start with block size (64Kb) */
-	int step = 0x10000;
-
-	for (int addr = start_addr; addr < end_addr; addr += step) {
-		if (write_enable() == -1) {
-			ret = -1;
-			break;
-		}
+	const std::vector<flash_erase_t> &types = _desc.erase;
+	const int gran = types[0].size;
+	const int start_addr = base_addr & ~(gran - 1);
+	const int end_addr = (base_addr + size + gran - 1) & ~(gran - 1);
+
+	/* whole device: a single chip erase */
+	if (_desc.size != 0 && start_addr == 0 &&
+			(uint32_t)end_addr >= _desc.size) {
+		printInfo("Erasing whole flash (May take time)");
+		return bulk_erase();
+	}
 
-		/* if block erase + addr end out of end_addr -> use sector_erase (4Kb) */
-		if (addr + 0x10000 > end_addr && _flash_model && _flash_model->subsector_erase) {
-			step = 0x1000;
-			ret = sector_erase(addr);
-		} else {
-			ret = block64_erase(addr);
+	/* cost[i]: min time to erase from unit i to end_addr
+	 * type[i]: erase type to use at unit i
+	 * unknown timing: estimated proportional to erase size
+	 */
+	const int nb_units = (end_addr - start_addr) / gran;
+	std::vector<uint64_t> cost(nb_units + 1, 0);
+	std::vector<int> type(nb_units, 0);
+	for (int i = nb_units - 1; i >= 0; i--) {
+		const int addr = start_addr + i * gran;
+		cost[i] = UINT64_MAX;
+		for (size_t t = 0; t < types.size(); t++) {
+			const int ers_size = types[t].size;
+			if ((addr & (ers_size - 1)) != 0 || addr + ers_size > end_addr)
+				continue;
+			const uint64_t c = cost[i + ers_size / gran] +
+				((types[t].typ_time) ? types[t].typ_time : 30 + ers_size / 512);
+			if (c < cost[i]) {
+				cost[i] = c;
+				type[i] = t;
+			}
 		}
+	}
 
-		if (ret == -1) {
-			break;
-		}
-		if (_spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00, 100000, false) == -1) {
+	ProgressBar progress("Erasing", end_addr - start_addr, 50, _verbose < 0);
+	for (int addr = start_addr; addr < end_addr;) {
+		const flash_erase_t &ers = types[type[(addr - start_addr) / gran]];
+		if (erase_area(ers, addr) == -1) {
 			ret = -1;
 			break;
 		}
-		progress.display(addr);
+		addr += ers.size;
+		progress.display(addr - start_addr);
 	}
 	if (ret == 0)
 		progress.done();
@@ -162,86 +306,230 @@ int SPIFlash::sectors_erase(int base_addr, int size)
 
 int SPIFlash::write_page(int addr, uint8_t *data, int len)
 {
-	uint8_t tx[len+3];
-	tx[0] = (uint8_t)(0xff & (addr >> 16));
-	tx[1] = (uint8_t)(0xff & (addr >>  8));
-	tx[2] = (uint8_t)(0xff & (addr      ));
+	const int alen = addr_len(addr + len);
+	if (alen < 0)
+		return -1;
+	uint8_t tx[len+alen];
+	put_addr(tx, addr, alen);
 
-	memcpy(tx+3, data, len);
+	memcpy(tx+alen, data, len);
 
-	if (write_enable() == -1)
+	if (write_enabled_cmd(addr_cmd(FLASH_PP), tx, len+alen) == -1)
 		return -1;
 
-	_spi->spi_put(FLASH_PP, tx, NULL, len+3);
 	return _spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00, 1000);
 }
 
+int SPIFlash::write_page_blind(int addr, uint8_t *data, int len)
+{
+	const int alen = addr_len(addr + len);
+	if (alen < 0)
+		return -1;
+	uint8_t tx[len+alen];
+	put_addr(tx, addr, alen);
+	memcpy(tx+alen, data, len);
+
+	if (_spi->spi_put_batch({
+			{FLASH_WREN, NULL, NULL, 0},
+			{addr_cmd(FLASH_PP), tx, NULL, (uint32_t)(len+alen)}}) != 0)
+		return -1;
+	if (_spi->spi_delay(_desc.pp_max_time))
+		return 0;
+	if (_spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00, 1000) != 0)
+		return -1;
+	return 1;
+}
+
 int SPIFlash::read(int base_addr, uint8_t *data, int len)
 {
-	uint8_t tx[len+3];
-	uint8_t rx[len+3];
-	tx[0] = (uint8_t)(0xff & (base_addr >> 16));
-	tx[1] = (uint8_t)(0xff & (base_addr >>  8));
-	tx[2] = (uint8_t)(0xff & (base_addr      ));
+	const int alen = addr_len(base_addr + len);
+	if (alen < 0)
+		return -1;
+	/* fast read: address followed by dummy cycles */
+	const flash_read_t &op = _desc.fast_read;
+	const int hdr_len = alen + op.dummy / 8;
+	const size_t xfer_len = len + hdr_len;
+
+	/* scratch buffers are kept between calls: bursts size is only
+	 * limited by the interface
+	 */
+	if (_rd_tx.size() < xfer_len) {
+		_rd_tx.resize(xfer_len, 0);
+		_rd_rx.resize(xfer_len);
+	}
+	put_addr(_rd_tx.data(), base_addr, alen);
+	memset(_rd_tx.data() + alen, 0, hdr_len - alen);
 
-	int ret = _spi->spi_put(0x03, tx, rx, len+3);
+	int ret = _spi->spi_put(addr_cmd(op.opcode), _rd_tx.data(),
+			_rd_rx.data(), xfer_len);
 	if (ret == 0)
-		memcpy(data, rx+3, len);
+		memcpy(data, _rd_rx.data() + hdr_len, len);
 	else
 		printf("error\n");
 	return ret;
 }
 
+/* number of buffers in dump ring: memory used is DUMP_RING_SIZE x burst */
+#define DUMP_RING_SIZE  4
+/* default burst when no rd_burst is provided */
+#define DUMP_BURST      0x40000
+/* streaming programming/verification window (multiple of erase sizes) */
+#define STREAM_WINDOW   0x40000
+
 bool SPIFlash::dump(const std::string &filename, const int &base_addr,
 		const int &len, int rd_burst)
 {
 	if (rd_burst == 0)
-		rd_burst = len;
-
-	/* segfault with buffer > 1M */
-	if (rd_burst > 0x100000)
-		rd_burst = 0x100000;
-
-	std::string data;
-	data.resize(rd_burst);
+		rd_burst = (len < DUMP_BURST) ? len : DUMP_BURST;
 
 	printInfo("dump flash (May take time)");
 
+	/* .gz extension: content is compressed on the fly */
+	const bool gz = filename.size() > 3 &&
+		filename.compare(filename.size() - 3, 3, ".gz") == 0;
+#ifndef HAS_ZLIB
+	if (gz) {
+		printError("openFPGALoader is build without zlib support\n"
+			"can't compress dump");
+		return false;
+	}
+#else
+	gzFile gzfd = NULL;
+#endif
+	FILE *fd = NULL;
+
 	printInfo("Open dump file ", false);
-	FILE *fd = fopen(filename.c_str(), "wb");
-	if (!fd) {
+#ifdef HAS_ZLIB
+	if (gz)
+		gzfd = gzopen(filename.c_str(), "wb");
+	else
+#endif
+		fd = fopen(filename.c_str(), "wb");
+	if (!fd
+#ifdef HAS_ZLIB
+		&& !gzfd
+#endif
+		) {
 		printError("FAIL");
 		return false;
 	} else {
 		printSuccess("DONE");
 	}
 
+	/* ring of reusable buffers: this thread fills them with flash
+	 * content (interfaces are not thread safe) while a writer thread
+	 * stores them into the file
+	 */
+	typedef struct {
+		std::vector<uint8_t> data;
+		int len;
+	} dump_buf_t;
+	std::vector<dump_buf_t> ring(DUMP_RING_SIZE);
+	std::mutex mtx;
+	std::condition_variable cv;
+	int head = 0, tail = 0, count = 0;
+	bool rd_end = false, wr_error = false;
+
+	std::thread writer([&]() {
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true) {
+			cv.wait(lock, [&]() { return count > 0 || rd_end; });
+			if (count == 0)
+				break;
+			dump_buf_t &buf = ring[tail];
+			lock.unlock();
+
+			bool ok;
+#ifdef HAS_ZLIB
+			if (gz)
+				ok = gzwrite(gzfd, buf.data.data(), buf.len) == buf.len;
+			else
+#endif
+				ok = fwrite(buf.data.data(), sizeof(uint8_t), buf.len, fd) ==
+					(size_t)buf.len;
+
+			lock.lock();
+			if (!ok) {
+				wr_error = true;
+				cv.notify_all();
+				break;
+			}
+			tail = (tail + 1) % DUMP_RING_SIZE;
+			count--;
+			cv.notify_all();
+		}
+	});
+
+	bool ret = true;
 	ProgressBar progress("Read flash ", len, 50, false);
+	progress.show_rate();
 	for (int i = 0; i < len; i += rd_burst) {
 		if (rd_burst + i > len)
 			rd_burst = len - i;
-		if (0 != read(base_addr + i, (uint8_t*)&data[0], rd_burst)) {
-			progress.fail();
+
+		/* wait for a free buffer */
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait(lock, [&]() { return count < DUMP_RING_SIZE || wr_error; });
+		if (wr_error) {
+			printError("Failed to write dump file");
+			ret = false;
+			break;
+		}
+		dump_buf_t &buf = ring[head];
+		lock.unlock();
+
+		if (buf.data.size() < (size_t)rd_burst)
+			buf.data.resize(rd_burst);
+		buf.len = rd_burst;
+		if (0 != read(base_addr + i, buf.data.data(), rd_burst)) {
 			printError("Failed to read flash");
-			fclose(fd);
-			return false;
+			ret = false;
+			break;
 		}
-		fwrite(data.c_str(), sizeof(uint8_t), rd_burst, fd);
-		progress.display(i);
+
+		lock.lock();
+		head = (head + 1) % DUMP_RING_SIZE;
+		count++;
+		cv.notify_all();
+		lock.unlock();
+		progress.display(i + rd_burst);
 	}
 
-	progress.done();
+	/* wait until all buffers are written */
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		rd_end = true;
+		cv.notify_all();
+	}
+	writer.join();
+	if (wr_error && ret) {
+		printError("Failed to write dump file");
+		ret = false;
+	}
 
-	fclose(fd);
+#ifdef HAS_ZLIB
+	if (gz) {
+		if (gzclose(gzfd) != Z_OK)
+			ret = false;
+	} else
+#endif
+		if (fclose(fd) != 0)
+			ret = false;
 
-	return true;
+	if (ret)
+		progress.done();
+	else
+		progress.fail();
+
+	return ret;
 }
 
-int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
+int SPIFlash::unlock_area(int base_addr, int len, bool &must_relock,
+		uint8_t &status)
 {
 	if (_jedec_id == 0)
 		read_id();
-	bool must_relock = false;  // used to relock after write;
+	must_relock = false;  // used to relock after write;
 
 	/* microchip SST26VF032B have global lock set
 	 * at powerup. global unlock must be send inconditionally
@@ -252,16 +540,16 @@ int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
 			return -1;
 	}
 	/* check Block Protect Bits (hide WIP/WEN bits) */
-	uint8_t status = read_status_reg() & ~0x03;
+	status = read_status_reg() & ~0x03;
 	if (_verbose > 0)
 		display_status_reg(status);
+	/* check if offset + len fit in flash (known chip or SFDP) */
+	if (_desc.size != 0 && (unsigned int)(base_addr + len) > _desc.size) {
+		printError("flash overflow");
+		return -1;
+	}
 	/* if known chip */
 	if (_flash_model) {
-		/* check if offset + len fit in flash */
-		if ((unsigned int)(base_addr + len) > (_flash_model->nr_sector * 0x10000) - 1) {
-			printError("flash overflow");
-			return -1;
-		}
 		/* compute protected area */
 		int8_t tb = get_tb();
 		if (tb == -1)
@@ -308,31 +596,361 @@ int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
 				return -1;
 		}
 	}
+	return 0;
+}
+
+void SPIFlash::relock_area(uint8_t status)
+{
+	enable_protection(status);
+	if (_verbose > 0)
+		display_status_reg(read_status_reg());
+}
+
+int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
+{
+	bool must_relock;
+	uint8_t status;
+	if (unlock_area(base_addr, len, must_relock, status) == -1)
+		return -1;
 
 	/* Now we can erase sector and write new data */
+	if (prog_area(base_addr, data, len) == -1)
+		return -1;
+
+	/* and if required: relock blocks */
+	if (must_relock)
+		relock_area(status);
+	return 0;
+}
+
+/* segments are grouped by erase unit (smallest erase type): areas are
+ * erased by whole units, so two segments in the same unit must be written
+ * by one call (gap is 0xff in data). Units without data are neither
+ * read nor erased
+ */
+int SPIFlash::erase_and_prog(int base_addr, uint8_t *data,
+		const std::vector<ConfigBitstreamParser::data_segment_t> &segments)
+{
+	if (segments.empty())
+		return 0;
+
+	const int start = base_addr + segments.front().addr;
+	const int len = segments.back().addr + segments.back().len -
+		segments.front().addr;
+	bool must_relock;
+	uint8_t status;
+	if (unlock_area(start, len, must_relock, status) == -1)
+		return -1;
+
+	const uint32_t unit_size = _desc.erase[0].size;
+	size_t i = 0;
+	while (i < segments.size()) {
+		const uint32_t first = segments[i].addr;
+		uint32_t end = first + segments[i].len;
+		/* append next segments starting in last unit */
+		for (i++; i < segments.size(); i++) {
+			const uint32_t last_unit = (base_addr + end - 1) & ~(unit_size - 1);
+			if (base_addr + segments[i].addr >= last_unit + unit_size)
+				break;
+			end = segments[i].addr + segments[i].len;
+		}
+
+		if (_verbose >= 0)
+			printf("area 0x%08x -> 0x%08x\n", base_addr + first,
+				base_addr + end - 1);
+		if (prog_area(base_addr + first, &data[first], end - first) == -1)
+			return -1;
+	}
+
+	/* and if required: relock blocks */
+	if (must_relock)
+		relock_area(status);
+	return 0;
+}
+
+/* data are consumed by windows aligned on STREAM_WINDOW (a multiple of
+ * all erase types): each window is erased/programmed before
+ * reading the next one, so only one window is kept in memory and flash
+ * is erased while remaining data are still read/decompressed.
+ * Per window steps are silent, a single progress bar is displayed
+ */
+int SPIFlash::erase_and_prog(int base_addr, FlashSource &src)
+{
+	const int len = src.size();
+	bool must_relock;
+	uint8_t status;
+	if (unlock_area(base_addr, len, must_relock, status) == -1)
+		return -1;
+
+	int window = STREAM_WINDOW;
+	for (auto &e : _desc.erase)
+		while (window < (int)e.size)
+			window *= 2;
+
+	std::vector<uint8_t> buf(window);
+	const int end_addr = base_addr + len;
+	const int8_t verbose = _verbose;
+	int ret = 0;
+
 	ProgressBar progress("Writing", len, 50, _verbose < 0);
+	_verbose = -1;
+	for (int addr = base_addr; addr < end_addr;) {
+		int next = (addr / window + 1) * window;
+		if (next > end_addr)
+			next = end_addr;
+		if (src.read(buf.data(), next - addr) != next - addr) {
+			printError("Error: fail to read data");
+			ret = -1;
+			break;
+		}
+		if (prog_area(addr, buf.data(), next - addr) == -1) {
+			ret = -1;
+			break;
+		}
+		addr = next;
+		progress.display(addr - base_addr);
+	}
+	_verbose = verbose;
+	if (ret == -1) {
+		progress.fail();
+		return -1;
+	}
+	progress.done();
+
+	if (must_relock)
+		relock_area(status);
+	return 0;
+}
+
+/* check if buf content is erased (0xff): bytes are merged 8 by 8
+ * without early exit so the loop is vectorised by the compiler
+ */
+static bool is_blank(const uint8_t *buf, int len)
+{
+	uint64_t acc = ~0ULL;
+	int i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t v;
+		memcpy(&v, buf + i, 8);
+		acc &= v;
+	}
+	for (; i < len; i++)
+		acc &= 0xffffffffffffff00ULL | buf[i];
+	return acc == ~0ULL;
+}
+
+/* differential programming: each erase unit (smallest erase type)
+ * is read back and compared to data:
+ *  - same content: nothing to do
+ *  - only 1 -> 0 transitions: pages are programmed without erase
+ *  - otherwise: unit is erased and its non blank pages are programmed
+ * bytes outside base_addr:base_addr+len in an erased unit are lost
+ * (same behavior as a full erase)
+ */
+int SPIFlash::diff_prog(int base_addr, uint8_t *data, int len)
+{
+	if (len <= 0)
+		return 0;
+
+	const int unit_size = _desc.erase[0].size;
+	const int psize = _desc.page_size;
+	const int end_addr = base_addr + len;
+	const int start_unit = base_addr & ~(unit_size - 1);
+	const int first_page = base_addr / psize;
+	const int nb_pages = (end_addr - 1) / psize - first_page + 1;
+	std::vector<bool> erase_unit((end_addr - start_unit + unit_size - 1) /
+		unit_size, false);
+	std::vector<bool> prog_page(nb_pages, false);
+	std::vector<uint8_t> cur(unit_size);
+	int nb_skip = 0, nb_noerase = 0, nb_erase = 0;
+
+	/* compare flash content with data */
+	ProgressBar cmp_progress("Comparing", len, 50, _verbose < 0);
+	for (int unit = 0, ua = start_unit; ua < end_addr; unit++, ua += unit_size) {
+		const int lo = (ua < base_addr) ? base_addr : ua;
+		const int hi = (ua + unit_size > end_addr) ? end_addr : ua + unit_size;
+		if (read(lo, cur.data(), hi - lo) != 0) {
+			cmp_progress.fail();
+			return -1;
+		}
+
+		bool must_erase = false, differs = false;
+		for (int page = lo / psize; page <= (hi - 1) / psize; page++) {
+			const int p_lo = (page * psize < lo) ? lo : page * psize;
+			const int p_hi = ((page + 1) * psize > hi) ? hi : (page + 1) * psize;
+			const uint8_t *c = &cur[p_lo - lo];
+			const uint8_t *d = &data[p_lo - base_addr];
+			if (memcmp(c, d, p_hi - p_lo) == 0)
+				continue;
+			differs = true;
+			prog_page[page - first_page] = true;
+			/* a bit set in data but clear in flash requires an erase */
+			for (int i = 0; i < p_hi - p_lo && !must_erase; i++)
+				must_erase = (c[i] & d[i]) != d[i];
+		}
+
+		if (must_erase) {
+			/* after erase blank pages are already in the right state */
+			erase_unit[unit] = true;
+			for (int page = lo / psize; page <= (hi - 1) / psize; page++) {
+				const int p_lo = (page * psize < lo) ? lo : page * psize;
+				const int p_hi = ((page + 1) * psize > hi) ? hi : (page + 1) * psize;
+				prog_page[page - first_page] =
+					!is_blank(&data[p_lo - base_addr], p_hi - p_lo);
+			}
+			nb_erase++;
+		} else if (differs) {
+			nb_noerase++;
+		} else {
+			nb_skip++;
+		}
+		cmp_progress.display(hi - base_addr);
+	}
+	cmp_progress.done();
+
+	if (_verbose >= 0) {
+		printInfo(std::to_string(nb_skip) + " unchanged, " +
+			std::to_string(nb_noerase) + " without erase, " +
+			std::to_string(nb_erase) + " to erase (" +
+			std::to_string(unit_size / 1024) + "KB units)");
+	}
+
+	/* erase consecutive units in one pass */
+	for (size_t unit = 0; unit < erase_unit.size(); unit++) {
+		if (!erase_unit[unit])
+			continue;
+		size_t last = unit;
+		while (last + 1 < erase_unit.size() && erase_unit[last + 1])
+			last++;
+		if (sectors_erase(start_unit + unit * unit_size,
+				(last - unit + 1) * unit_size) == -1)
+			return -1;
+		unit = last;
+	}
+
+	return prog_pages(base_addr, data, len, prog_page);
+}
+
+/* default mode: area is erased then its non blank pages are programmed
+ * (blank pages are already in the right state after erase)
+ */
+int SPIFlash::prog_area(int base_addr, uint8_t *data, int len)
+{
+	if (_diff_prog)
+		return diff_prog(base_addr, data, len);
+	if (len <= 0)
+		return 0;
+
 	if (sectors_erase(base_addr, len) == -1)
 		return -1;
 
-	uint8_t *ptr = data;
-	int size = 0;
-	for (int addr = 0; addr < len; addr += size, ptr+=size) {
-		size = (addr + 256 > len)?(len-addr) : 256;
-		if (write_page(base_addr + addr, ptr, size) == -1)
+	const int psize = _desc.page_size;
+	const int first_page = base_addr / psize;
+	const int nb_pages = (base_addr + len - 1) / psize - first_page + 1;
+	std::vector<bool> prog_page(nb_pages);
+	for (int page = 0; page < nb_pages; page++) {
+		const int lo = std::max(base_addr, (first_page + page) * psize);
+		const int hi = std::min(base_addr + len, (first_page + page + 1) * psize);
+		prog_page[page] = !is_blank(&data[lo - base_addr], hi - lo);
+	}
+	return prog_pages(base_addr, data, len, prog_page);
+}
+
+/* pages are aligned on flash pages. In blind mode pages are streamed
+ * without status polling, each one followed by the max page program
+ * time, and status is checked once at the end
+ */
+int SPIFlash::prog_pages(int base_addr, uint8_t *data, int len,
+		const std::vector<bool> &prog_page)
+{
+	const int psize = _desc.page_size;
+	const int end_addr = base_addr + len;
+	const int first_page = base_addr / psize;
+	const int nb_pages = static_cast<int>(prog_page.size());
+
+	bool blind = _blind_prog && _desc.pp_max_time != 0;
+	if (_blind_prog && !blind && _verbose >= 0)
+		printWarn("Blind page program: unknown page program time, "
+			"status is polled");
+	bool blind_used = false;
+	ProgressBar progress("Writing", len, 50, _verbose < 0);
+	for (int page = 0; page < nb_pages; page++) {
+		if (!prog_page[page])
+			continue;
+		const int addr = std::max(base_addr, (first_page + page) * psize);
+		const int next = std::min(end_addr, (first_page + page + 1) * psize);
+		int ret;
+		if (blind) {
+			ret = write_page_blind(addr, &data[addr - base_addr], next - addr);
+			/* interface unable to insert delay: back to polling */
+			if (ret == 1)
+				blind = false;
+			else if (ret == 0)
+				blind_used = true;
+		} else {
+			ret = write_page(addr, &data[addr - base_addr], next - addr);
+		}
+		if (ret == -1) {
+			progress.fail();
 			return -1;
-		progress.display(addr);
+		}
+		progress.display(addr - base_addr);
+	}
+	if (blind_used && _spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP | FLASH_RDSR_WEL,
+				0x00, 1000) != 0) {
+		progress.fail();
+		printError("Blind page program: flash still busy");
+		return -1;
 	}
 	progress.done();
 
-	/* and if required: relock blocks */
-	if (must_relock) {
-		enable_protection(status);
-		if (_verbose > 0)
-			display_status_reg(read_status_reg());
-	}
 	return 0;
 }
 
+/* blank pages are not programmed but only erased (see prog_area):
+ * only runs of non blank pages are read back and compared
+ */
+bool SPIFlash::verify_area(int base_addr, const uint8_t *data, int len,
+		uint8_t *rd_buf)
+{
+	const int psize = _desc.page_size;
+	int pos = 0;
+	while (pos < len) {
+		int run_end = pos;
+		bool blank = true;
+		while (run_end < len) {
+			int next = ((base_addr + run_end) / psize + 1) * psize - base_addr;
+			if (next > len)
+				next = len;
+			const bool page_blank = is_blank(&data[run_end], next - run_end);
+			if (run_end != pos && page_blank != blank)
+				break;
+			blank = page_blank;
+			run_end = next;
+		}
+		if (blank) {
+			pos = run_end;
+			continue;
+		}
+
+		uint8_t *rd = &rd_buf[pos];
+		if (0 != read(base_addr + pos, rd, run_end - pos)) {
+			printError("Failed to read flash");
+			return false;
+		}
+
+		for (int ii = 0; ii < run_end - pos; ii++) {
+			if (rd[ii] != data[pos + ii]) {
+				printError("Verification failed at " +
+						std::to_string(base_addr + pos + ii));
+				return false;
+			}
+		}
+		pos = run_end;
+	}
+	return true;
+}
+
 bool SPIFlash::verify(const int &base_addr, const uint8_t *data,
 		const int &len, int rd_burst)
 {
@@ -341,26 +959,87 @@ bool SPIFlash::verify(const int &base_addr, const uint8_t *data,
 
 	printInfo("Verifying write (May take time)");
 
-	std::string verify_data;
-	verify_data.resize(rd_burst);
+	std::vector<uint8_t> verify_data(rd_burst);
 
 	ProgressBar progress("Read flash ", len, 50, false);
 	for (int i = 0; i < len; i += rd_burst) {
 		if (rd_burst + i > len)
 			rd_burst = len - i;
-		if (0 != read(base_addr + i, (uint8_t*)&verify_data[0], rd_burst)) {
+		if (!verify_area(base_addr + i, &data[i], rd_burst,
+					verify_data.data())) {
 			progress.fail();
-			printError("Failed to read flash");
 			return false;
 		}
+		progress.display(i);
+	}
 
-		for (int ii = 0; ii < rd_burst; ii++) {
-			if ((uint8_t)verify_data[ii] != data[i+ii]) {
+	progress.done();
+
+	return true;
+}
+
+bool SPIFlash::verify(const int &base_addr, const uint8_t *data,
+		const std::vector<ConfigBitstreamParser::data_segment_t> &segments,
+		int rd_burst)
+{
+	int len = 0, max_len = 0;
+	for (auto &seg : segments) {
+		len += seg.len;
+		if ((int)seg.len > max_len)
+			max_len = seg.len;
+	}
+	if (rd_burst == 0 || rd_burst > max_len)
+		rd_burst = max_len;
+
+	printInfo("Verifying write (May take time)");
+
+	std::vector<uint8_t> verify_data(rd_burst);
+
+	ProgressBar progress("Read flash ", len, 50, false);
+	int done = 0;
+	for (auto &seg : segments) {
+		for (uint32_t i = 0; i < seg.len; i += rd_burst) {
+			const int size = (i + rd_burst > seg.len) ? seg.len - i : rd_burst;
+			if (!verify_area(base_addr + seg.addr + i, &data[seg.addr + i],
+						size, verify_data.data())) {
 				progress.fail();
-				printError("Verification failed at " +
-						std::to_string(base_addr + i + ii));
 				return false;
 			}
+			done += size;
+			progress.display(done);
+		}
+	}
+
+	progress.done();
+
+	return true;
+}
+
+bool SPIFlash::verify(const int &base_addr, FlashSource &src)
+{
+	printInfo("Verifying write (May take time)");
+
+	if (!src.rewind()) {
+		printError("Error: fail to read data again");
+		return false;
+	}
+
+	const int len = src.size();
+	std::vector<uint8_t> data(STREAM_WINDOW);
+	std::vector<uint8_t> verify_data(STREAM_WINDOW);
+
+	ProgressBar progress("Read flash ", len, 50, false);
+	for (int i = 0; i < len; i += STREAM_WINDOW) {
+		const int size = (i + STREAM_WINDOW > len) ? len - i : STREAM_WINDOW;
+		if (src.read(data.data(), size) != size) {
+			progress.fail();
+			printError("Error: fail to read data");
+			return false;
+		}
+		if (!verify_area(base_addr + i, data.data(), size,
+					verify_data.data())) {
+			progress.fail();
+			return false;
 		}
 		progress.display(i);
 	}
@@ -402,7 +1081,19 @@ void SPIFlash::read_id()
 				_flash_model->manufacturer.c_str(), _flash_model->model.c_str(),
 				_flash_model->nr_sector, _flash_model->nr_sector * 0x80000 / 1048576);
 		printInfo(content);
-	} else {
+	}
+
+	init_desc();
+	const bool has_sfdp = read_sfdp();
+	init_addr_mode();
+	if (has_sfdp && !_flash_model) {
+		char content[256];
+		snprintf(content, 256, "Detected with SFDP: %uKB page %uB",
+				_desc.size / 1024, _desc.page_size);
+		printInfo(content);
+	}
+
+	if (!_flash_model) {
 		/* read extented */
 		if ((_jedec_id & 0xff) != 0) {
 			has_edid = true;
@@ -431,6 +1122,210 @@ void SPIFlash::read_id()
 	}
 }
 
+void SPIFlash::init_desc()
+{
+	_desc.sfdp = false;
+	_desc.size = 0;
+	_desc.page_size = 256;
+	_desc.erase.clear();
+	_desc.ce_typ_time = 0;
+	_desc.ce_max_time = 0;
+	_desc.pp_typ_time = 0;
+	_desc.pp_max_time = 0;
+	_desc.addr4 = false;
+	_desc.addr4_only = false;
+	_desc.addr4_enter = 0;
+	_desc.fast_read = {0x0B, 8};
+	_desc.dual_read = {0, 0};
+	_desc.quad_read = {0, 0};
+
+	if (!_flash_model) {
+		/* unknown chip: 64KB erase is always available */
+		_desc.erase.push_back({0x10000, FLASH_BE64, 0, 0});
+		return;
+	}
+
+	_desc.size = _flash_model->nr_sector * 0x10000;
+	if (_desc.size > 0x1000000) {
+		/* EN4B preceded by write enable works for all known chips */
+		_desc.addr4 = true;
+		_desc.addr4_enter = 0x02;
+	}
+	if (_flash_model->subsector_erase)
+		_desc.erase.push_back({0x1000, FLASH_SE, _flash_model->se_time, 0});
+	if (_flash_model->block32_erase)
+		_desc.erase.push_back({0x8000, FLASH_BE32, _flash_model->be32_time, 0});
+	_desc.erase.push_back({0x10000, FLASH_BE64, _flash_model->be64_time, 0});
+	_desc.ce_typ_time = _flash_model->ce_time;
+	_desc.pp_max_time = _flash_model->pp_time;
+}
+
+int SPIFlash::sfdp_read(uint32_t addr, uint8_t *data, int len)
+{
+	std::vector<uint8_t> tx(len + 4, 0), rx(len + 4);
+	tx[0] = (uint8_t)(0xff & (addr >> 16));
+	tx[1] = (uint8_t)(0xff & (addr >>  8));
+	tx[2] = (uint8_t)(0xff & (addr      ));
+	/* tx[3]: 8 dummy cycles */
+
+	int ret = _spi->spi_put(FLASH_RDSFDP, tx.data(), rx.data(), len + 4);
+	if (ret == 0)
+		memcpy(data, rx.data() + 4, len);
+	return ret;
+}
+
+/* JESD216 Basic Flash Parameter Table (BFPT) DWORDs (0 based):
+ *  0: 4KB erase, address bytes, 1-1-2/1-1-4 support
+ *  1: density
+ *  2: 1-1-4 instruction, 3: 1-1-2 instruction
+ *  7-8: erase types (size/instruction)
+ *  9: erase types typical times (JESD216A)
+ * 10: page size, page program and chip erase times (JESD216A)
+ * 15: 4-Byte address mode entry methods (JESD216B)
+ */
+bool SPIFlash::read_sfdp()
+{
+	uint8_t hdr[8];
+	if (sfdp_read(0, hdr, 8) != 0 || memcmp(hdr, "SFDP", 4) != 0) {
+		if (_verbose > 0)
+			printInfo("No SFDP");
+		return false;
+	}
+
+	/* parameter headers: search BFPT (ID 0xFF00) */
+	const int nph = hdr[6] + 1;
+	std::vector<uint8_t> ph(8 * nph);
+	if (sfdp_read(8, ph.data(), 8 * nph) != 0)
+		return false;
+	int bfpt_len = 0;
+	uint32_t bfpt_ptr = 0;
+	for (int i = 0; i < nph; i++) {
+		const uint8_t *h = &ph[8 * i];
+		/* a table may be present several times: keep the longest */
+		if (h[0] == 0x00 && h[7] == 0xff && h[3] > bfpt_len) {
+			bfpt_len = h[3];
+			bfpt_ptr = h[4] | (h[5] << 8) | (h[6] << 16);
+		}
+	}
+	/* JESD216 (first version) BFPT contains 9 DWORDs */
+	if (bfpt_len < 9) {
+		printWarn("SFDP: no valid basic flash parameter table");
+		return false;
+	}
+
+	std::vector<uint8_t> raw(4 * bfpt_len);
+	if (sfdp_read(bfpt_ptr, raw.data(), 4 * bfpt_len) != 0)
+		return false;
+	std::vector<uint32_t> dw(bfpt_len);
+	for (int i = 0; i < bfpt_len; i++)
+		dw[i] = raw[4 * i] | (raw[4 * i + 1] << 8) |
+			(raw[4 * i + 2] << 16) | ((uint32_t)raw[4 * i + 3] << 24);
+
+	/* density: in bits */
+	uint64_t size;
+	if (dw[1] & (1u << 31)) {
+		const uint32_t density_shift = dw[1] & 0x7fffffff;
+		if (density_shift >= 64) {
+			printWarn("SFDP: invalid density");
+			return false;
+		}
+		size = (1ULL << density_shift) / 8;
+	} else
+		size = ((uint64_t)dw[1] + 1) / 8;
+	if (size == 0 || size > 0x80000000ULL) {
+		printWarn("SFDP: invalid density");
+		return false;
+	}
+
+	/* erase types and typical times */
+	const uint32_t ers_unit[4] = {1, 16, 128, 1000};
+	const uint32_t ers_mult = (bfpt_len >= 10) ? 2 * ((dw[9] & 0x0f) + 1) : 0;
+	const int ers_time_shift[4] = {4, 11, 18, 25};
+	std::vector<flash_erase_t> erase;
+	for (int t = 0; t < 4; t++) {
+		const uint32_t val = (dw[7 + t / 2] >> (16 * (t & 1))) & 0xffff;
+		const uint8_t size_shift = val & 0xff;
+		if (size_shift == 0)
+			continue;
+		if (size_shift >= 32) {
+			printWarn("SFDP: invalid erase size");
+			return false;
+		}
+		flash_erase_t ers = {1u << size_shift, (uint8_t)(val >> 8), 0, 0};
+		if (bfpt_len >= 10) {
+			const uint32_t field = dw[9] >> ers_time_shift[t];
+			ers.typ_time = ((field & 0x1f) + 1) * ers_unit[(field >> 5) & 0x03];
+			ers.max_time = ers.typ_time * ers_mult;
+		} else {
+			/* keep flash_list timing when available */
+			for (auto &e : _desc.erase)
+				if (e.size == ers.size)
+					ers.typ_time = e.typ_time;
+		}
+		/* keep erase types sorted: smallest first */
+		auto pos = erase.begin();
+		while (pos != erase.end() && pos->size < ers.size)
+			pos++;
+		erase.insert(pos, ers);
+	}
+	if (erase.empty()) {
+		printWarn("SFDP: no erase type");
+		return false;
+	}
+
+	_desc.sfdp = true;
+	_desc.size = (uint32_t)size;
+	_desc.erase = erase;
+
+	/* page size and chip erase time */
+	if (bfpt_len >= 11) {
+		const uint32_t ce_unit[4] = {16, 256, 4000, 64000};
+		_desc.page_size = 1 << ((dw[10] >> 4) & 0x0f);
+		_desc.ce_typ_time = (((dw[10] >> 24) & 0x1f) + 1) *
+			ce_unit[(dw[10] >> 29) & 0x03];
+		_desc.ce_max_time = _desc.ce_typ_time * ers_mult;
+		_desc.pp_typ_time = (((dw[10] >> 8) & 0x1f) + 1) *
+			((dw[10] & (1 << 13)) ? 64 : 8);
+		_desc.pp_max_time = _desc.pp_typ_time * 2 * ((dw[10] & 0x0f) + 1);
+	}
+
+	/* address bytes: 0: 3B only, 1: 3B or 4B, 2: 4B only */
+	const uint8_t addr_bytes = (dw[0] >> 17) & 0x03;
+	_desc.addr4 = addr_bytes == 1 || addr_bytes == 2;
+	_desc.addr4_only = addr_bytes == 2;
+	if (bfpt_len >= 16)
+		_desc.addr4_enter = (dw[15] >> 24) & 0xff;
+
+	/* fast reads: dummy = wait states + mode clocks */
+	if (dw[0] & (1 << 16))
+		_desc.dual_read = {(uint8_t)((dw[3] >> 8) & 0xff),
+			(uint8_t)((dw[3] & 0x1f) + ((dw[3] >> 5) & 0x07))};
+	if (dw[0] & (1 << 22))
+		_desc.quad_read = {(uint8_t)((dw[2] >> 24) & 0xff),
+			(uint8_t)(((dw[2] >> 16) & 0x1f) + ((dw[2] >> 21) & 0x07))};
+
+	if (_verbose > 0) {
+		printf("SFDP v%d.%d: %u Byte, page %u Byte, %s address\n",
+				hdr[5], hdr[4], _desc.size, _desc.page_size,
+				(_desc.addr4_only) ? "4B" : (_desc.addr4) ? "3B/4B" : "3B");
+		for (auto &e : _desc.erase)
+			printf("  erase %6u Byte: %02x typ %u ms max %u ms\n",
+					e.size, e.opcode, e.typ_time, e.max_time);
+		printf("  chip erase typ %u ms max %u ms\n",
+				_desc.ce_typ_time, _desc.ce_max_time);
+		printf("  page program typ %u us max %u us\n",
+				_desc.pp_typ_time, _desc.pp_max_time);
+		if (_desc.dual_read.opcode)
+			printf("  1-1-2 read: %02x %u dummy\n",
+					_desc.dual_read.opcode, _desc.dual_read.dummy);
+		if (_desc.quad_read.opcode)
+			printf("  1-1-4 read: %02x %u dummy\n",
+					_desc.quad_read.opcode, _desc.quad_read.dummy);
+	}
+
+	return true;
+}
+
 void SPIFlash::display_status_reg(uint8_t reg)
 {
 	uint8_t tb, bp;
@@ -518,7 +1413,16 @@ void SPIFlash::power_down()
 
 int SPIFlash::write_enable()
 {
-	_spi->spi_put(FLASH_WREN, NULL, NULL, 0);
+	uint8_t status = 0;
+	/* WREN and first status read in one batch: WEL is only polled
+	 * when not already set
+	 */
+	if (_spi->spi_put_batch({
+			{FLASH_WREN, NULL, NULL, 0},
+			{FLASH_RDSR, NULL, &status, 1}}) != 0)
+		return -1;
+	if (status & FLASH_RDSR_WEL)
+		return 0;
 	/* wait WEL */
 	if (_spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WEL, FLASH_RDSR_WEL, 1000)) {
 		printf("write en: Error\n");
@@ -8,13 +8,57 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
+#include "configBitstreamParser.hpp"
+#include "flashSource.hpp"
 #include "spiInterface.hpp"
 #include "spiFlashdb.hpp"
 
+/*!
+ * \brief erase instruction
+ */
+typedef struct {
+	uint32_t size;     /**< erased area (Byte) */
+	uint8_t opcode;    /**< instruction */
+	uint32_t typ_time; /**< typical erase time (ms), 0: unknown */
+	uint32_t max_time; /**< maximum erase time (ms), 0: unknown */
+} flash_erase_t;
+
+/*!
+ * \brief read instruction
+ */
+typedef struct {
+	uint8_t opcode;    /**< instruction, 0: unsupported */
+	uint8_t dummy;     /**< dummy cycles (mode cycles included) */
+} flash_read_t;
+
+/*!
+ * \brief runtime flash description: filled with flash_list
+ *        content when chip is known and updated with SFDP (JESD216)
+ *        tables when available
+ */
+typedef struct {
+	bool sfdp;                        /**< filled with SFDP content */
+	uint32_t size;                    /**< flash size (Byte), 0: unknown */
+	uint32_t page_size;               /**< program page size (Byte) */
+	std::vector<flash_erase_t> erase; /**< erase types, smallest first */
+	uint32_t ce_typ_time;             /**< typical chip erase time (ms) */
+	uint32_t ce_max_time;             /**< maximum chip erase time (ms) */
+	uint32_t pp_typ_time;             /**< typical page program time (us) */
+	uint32_t pp_max_time;             /**< maximum page program time (us) */
+	bool addr4;                       /**< 4-Byte address supported */
+	bool addr4_only;                  /**< 3-Byte address unsupported */
+	uint8_t addr4_enter;              /**< 4-Byte mode entry methods */
+	flash_read_t fast_read;           /**< 1-1-1 fast read */
+	flash_read_t dual_read;           /**< 1-1-2 fast read */
+	flash_read_t quad_read;           /**< 1-1-4 fast read */
+} flash_desc_t;
+
 class SPIFlash {
 	public:
 		SPIFlash(SPIInterface *spi, bool unprotect, int8_t verbose);
+		virtual ~SPIFlash();
 		/* power */
 		virtual void power_up();
 		virtual void power_down();
@@ -65,6 +109,17 @@ class SPIFlash {
 		int sectors_erase(int base_addr, int len);
 		/* write */
 		int write_page(int addr, uint8_t *data, int len);
+		/*!
+		 * \brief write one page without status polling: WEL is not
+		 *        checked and WIP polling is replaced by a delay
+		 *        of the maximum page program time
+		 * \param[in] addr: page address
+		 * \param[in] data: page content
+		 * \param[in] len: number of Byte to write
+		 * \return -1 if write fails, 1 when interface can't insert
+		 *         delay (page completion polled), 0 otherwise
+		 */
+		int write_page_blind(int addr, uint8_t *data, int len);
 		/* read */
 		int read(int base_addr, uint8_t *data, int len);
 		/*!
@@ -80,6 +135,35 @@ class SPIFlash {
 				const int &len, int rd_burst = 0);
 		/* combo flash + erase */
 		int erase_and_prog(int base_addr, uint8_t *data, int len);
+		/*!
+		 * \brief erase and program flash with src content: data are
+		 *        read and written by windows, the whole content is
+		 *        never stored in memory
+		 * \param[in] base_addr: base address to write
+		 * \param[in] src: data source
+		 * \return -1 if read, erase or write fails, 0 otherwise
+		 */
+		int erase_and_prog(int base_addr, FlashSource &src);
+		/*!
+		 * \brief erase and program only populated areas of data:
+		 *        segments sharing an erase unit are programmed
+		 *        together, other units are left untouched
+		 * \param[in] base_addr: flash address of data[0]
+		 * \param[in] data: image
+		 * \param[in] segments: populated areas of data (sorted)
+		 * \return -1 if read, erase or write fails, 0 otherwise
+		 */
+		int erase_and_prog(int base_addr, uint8_t *data,
+			const std::vector<ConfigBitstreamParser::data_segment_t> &segments);
+		/*!
+		 * \brief compare flash content with data and erase/program
+		 *        only erase units/pages which differ
+		 * \param[in] base_addr: base address to write
+		 * \param[in] data: new area content
+		 * \param[in] len: length (in Byte) of data
+		 * \return -1 if read, erase or write fails, 0 otherwise
+		 */
+		int diff_prog(int base_addr, uint8_t *data, int len);
 		/*!
 		 * \brief check if area base_addr to base_addr + len match
 		 *        data content
@@ -91,12 +175,42 @@ class SPIFlash {
 		 */
 		bool verify(const int &base_addr, const uint8_t *data,
 				const int &len, int rd_burst = 0);
+		/*!
+		 * \brief check if flash content, starting at base_addr,
+		 *        match src content (src is rewinded first)
+		 * \param[in] base_addr: base address to read
+		 * \param[in] src: theorical area content
+		 * \return false if read fails or content didn't match, true otherwise
+		 */
+		bool verify(const int &base_addr, FlashSource &src);
+		/*!
+		 * \brief check if flash content match populated areas of data
+		 * \param[in] base_addr: flash address of data[0]
+		 * \param[in] data: theorical image
+		 * \param[in] segments: populated areas of data
+		 * \param[in] rd_burst: size of packet to read
+		 * \return false if read fails or content didn't match, true otherwise
+		 */
+		bool verify(const int &base_addr, const uint8_t *data,
+			const std::vector<ConfigBitstreamParser::data_segment_t> &segments,
+			int rd_burst = 0);
 		/* return status register value */
 		uint8_t read_status_reg();
 		/* display/info */
 		void display_status_reg(uint8_t reg);
 		void display_status_reg() {display_status_reg(read_status_reg());}
 		virtual void read_id();
+		/*!
+		 * \brief read and parse JESD216 SFDP tables to update
+		 *        flash description (geometry, erase types/timings,
+		 *        addressing mode and read instructions)
+		 * \return false if flash has no (valid) SFDP
+		 */
+		bool read_sfdp();
+		/*!
+		 * \brief return flash description
+		 */
+		const flash_desc_t &get_desc() const { return _desc; }
 		uint16_t readNonVolatileCfgReg();
 		uint16_t readVolatileCfgReg();
 
@@ -123,12 +237,117 @@ class SPIFlash {
 		 * \return bp code (based on chip bp[x] position)
 		 */
 		uint8_t len_to_bp(uint32_t len);
+		/*!
+		 * \brief fill flash description with flash_list content
+		 *        (or conservative values when chip is unknown)
+		 */
+		void init_desc();
+		/*!
+		 * \brief read SFDP area
+		 * \param[in] addr: SFDP address
+		 * \param[out] data: buffer to fill
+		 * \param[in] len: number of Byte to read
+		 * \return != 0 if read fails
+		 */
+		int sfdp_read(uint32_t addr, uint8_t *data, int len);
+		/*!
+		 * \brief send one erase instruction and wait for completion
+		 * \param[in] erase: erase type
+		 * \param[in] addr: address of the area to erase
+		 * \return -1 if erase fails
+		 */
+		int erase_area(const flash_erase_t &erase, int addr);
+		/*!
+		 * \brief select how addresses above 16MB are reached:
+		 *        dedicated 4-Byte instructions, always 4-Byte
+		 *        device or EN4B (entered on first access above 16MB)
+		 */
+		void init_addr_mode();
+		/*!
+		 * \brief return address length required to access up to
+		 *        end_addr (excluded), enter 4-Byte mode if needed
+		 * \return 3 or 4, -1 if end_addr can't be reached
+		 */
+		int addr_len(uint32_t end_addr);
+		/*!
+		 * \brief leave 4-Byte address mode if entered with EN4B
+		 */
+		void exit_addr4();
+		/*!
+		 * \brief convert instruction to its 4-Byte address version
+		 *        when dedicated instructions are used
+		 */
+		uint8_t addr_cmd(uint8_t cmd);
+		/*!
+		 * \brief send an instruction followed by an address
+		 * \return -1 if addr can't be reached
+		 */
+		int send_addr_cmd(uint8_t cmd, uint32_t addr);
+		/*!
+		 * \brief send WREN, status read and cmd in one batch. When
+		 *        WEL was not set, WEL is polled and cmd sent again
+		 * \param[in] cmd: instruction
+		 * \param[in] tx: bytes following cmd
+		 * \param[in] len: tx length
+		 * \return -1 if write enable fails
+		 */
+		int write_enabled_cmd(uint8_t cmd, const uint8_t *tx, uint32_t len);
+		/*!
+		 * \brief check flash size and block protection before writing
+		 *        base_addr to base_addr + len, unlock if allowed
+		 * \param[out] must_relock: protection must be restored
+		 * \param[out] status: status register to restore
+		 * \return -1 if area can't be written
+		 */
+		int unlock_area(int base_addr, int len, bool &must_relock,
+				uint8_t &status);
+		/*!
+		 * \brief restore block protection saved by unlock_area
+		 */
+		void relock_area(uint8_t status);
+		/*!
+		 * \brief erase and program one area: with diff mode only
+		 *        modified areas are erased/programmed (see diff_prog),
+		 *        otherwise area is erased then programmed
+		 * \param[in] base_addr: base address to write
+		 * \param[in] data: new area content
+		 * \param[in] len: length (in Byte) of data
+		 * \return -1 if read, erase or write fails, 0 otherwise
+		 */
+		int prog_area(int base_addr, uint8_t *data, int len);
+		/*!
+		 * \brief program selected pages of an area (already erased
+		 *        when required), with status polling or in blind mode
+		 * \param[in] base_addr: base address of data
+		 * \param[in] data: area content
+		 * \param[in] len: length (in Byte) of data
+		 * \param[in] prog_page: pages to program
+		 * \return -1 if write fails, 0 otherwise
+		 */
+		int prog_pages(int base_addr, uint8_t *data, int len,
+			const std::vector<bool> &prog_page);
+		/*!
+		 * \brief compare len Byte starting at base_addr with data,
+		 *        blank pages are skipped
+		 * \param[in] rd_buf: scratch buffer (len Byte)
+		 * \return false if read fails or content didn't match
+		 */
+		bool verify_area(int base_addr, const uint8_t *data, int len,
+				uint8_t *rd_buf);
 
 		SPIInterface *_spi;
 		int8_t _verbose;
 		uint32_t _jedec_id; /**< CHIP ID */
 		flash_t *_flash_model; /**< detect flash model */
+		flash_desc_t _desc; /**< runtime flash description */
 		bool _unprotect; /**< allows to unprotect memory before write */
+		int _addr_len;       /**< current address length (Byte) */
+		bool _addr4_opcodes; /**< use 4-Byte dedicated instructions */
+		bool _addr4_entered; /**< 4-Byte mode entered with EN4B */
+		bool _diff_prog;     /**< only erase/program modified areas */
+		bool _blind_prog;    /**< program pages without status polling */
+		std::vector<uint8_t> _rd_tx; /**< read scratch buffer (tx) */
+		std::vector<uint8_t> _rd_rx; /**< read scratch buffer (rx) */
 };
 
 #endif  // SRC_SPIFLASH_HPP_
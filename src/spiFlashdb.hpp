@@ -22,8 +22,14 @@ typedef struct {
 	std::string model;        /**< chip name */
 	uint32_t nr_sector;       /**< number of sectors */
 	bool sector_erase;        /**< 64KB erase support */
-	/* missing 32KB erase */
+	bool block32_erase;       /**< 32KB erase support */
 	bool subsector_erase;     /**< 4KB erase support */
+	/* typical erase times (ms) used to plan erase, 0: unknown */
+	uint16_t se_time;         /**< 4KB erase time */
+	uint16_t be32_time;       /**< 32KB erase time */
+	uint16_t be64_time;       /**< 64KB erase time */
+	uint32_t ce_time;         /**< chip erase time */
+	uint16_t pp_time;         /**< max page program time (us), 0: unknown */
 	bool has_extended;
 	bool tb_otp;              /**< TOP/BOTTOM One Time Programming */
 	uint8_t tb_offset;        /**< TOP/BOTTOM bit offset */
@@ -38,7 +44,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "S25FL064P / EPCS64",
 		.nr_sector = 128,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
+		.se_time = 50,
+		.be32_time = 0,
+		.be64_time = 500,
+		.ce_time = 64000,
+		.pp_time = 3000,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -51,7 +63,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "S25FL128S",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = false,
+		.se_time = 0,
+		.be32_time = 0,
+		.be64_time = 130,
+		.ce_time = 33000,
+		.pp_time = 750,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -64,7 +82,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "N25Q32",
 		.nr_sector = 64,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
+		.se_time = 250,
+		.be32_time = 0,
+		.be64_time = 700,
+		.ce_time = 15000,
+		.pp_time = 5000,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -77,7 +101,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "N25Q128",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
+		.se_time = 250,
+		.be32_time = 0,
+		.be64_time = 700,
+		.ce_time = 170000,
+		.pp_time = 5000,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -90,7 +120,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "N25Q256",
 		.nr_sector = 512,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
+		.se_time = 250,
+		.be32_time = 0,
+		.be64_time = 700,
+		.ce_time = 240000,
+		.pp_time = 5000,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -103,7 +139,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "IS25LP032",
 		.nr_sector = 64,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
+		.se_time = 70,
+		.be32_time = 100,
+		.be64_time = 150,
+		.ce_time = 10000,
+		.pp_time = 800,
 		.has_extended = false,
 		.tb_otp = true,
 		.tb_offset = (1 << 1),
@@ -116,7 +158,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "IS25LP064",
 		.nr_sector = 128,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
+		.se_time = 70,
+		.be32_time = 100,
+		.be64_time = 150,
+		.ce_time = 20000,
+		.pp_time = 800,
 		.has_extended = false,
 		.tb_otp = true,
 		.tb_offset = (1 << 1),
@@ -129,7 +177,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "IS25LP128",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
+		.se_time = 70,
+		.be32_time = 100,
+		.be64_time = 150,
+		.ce_time = 40000,
+		.pp_time = 800,
 		.has_extended = false,
 		.tb_otp = true,
 		.tb_offset = (1 << 1),
@@ -142,7 +196,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "W25Q16",
 		.nr_sector = 32,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
+		.se_time = 45,
+		.be32_time = 120,
+		.be64_time = 150,
+		.ce_time = 5000,
+		.pp_time = 3000,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -155,7 +215,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "W25Q32",
 		.nr_sector = 64,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
+		.se_time = 45,
+		.be32_time = 120,
+		.be64_time = 150,
+		.ce_time = 10000,
+		.pp_time = 3000,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -168,7 +234,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "W25Q64",
 		.nr_sector = 128,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
+		.se_time = 45,
+		.be32_time = 120,
+		.be64_time = 150,
+		.ce_time = 20000,
+		.pp_time = 3000,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -181,7 +253,13 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "W25Q128",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
+		.se_time = 45,
+		.be32_time = 120,
+		.be64_time = 150,
+		.ce_time = 40000,
+		.pp_time = 3000,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
@@ -6,20 +6,32 @@
 #include <iostream>
 #include <vector>
 
+#include "configBitstreamParser.hpp"
 #include "display.hpp"
 #include "spiInterface.hpp"
 #include "spiFlash.hpp"
 
 SPIInterface::SPIInterface():_spif_verbose(0), _spif_rd_burst(0),
-	_spif_verify(false)
+	_spif_verify(false), _spif_diff_prog(false), _spif_blind_prog(false)
 {}
 
 SPIInterface::SPIInterface(const std::string &filename, uint8_t verbose,
 		uint32_t rd_burst, bool verify):
 	_spif_verbose(verbose), _spif_rd_burst(rd_burst),
-	_spif_verify(verify), _spif_filename(filename)
+	_spif_verify(verify), _spif_diff_prog(false), _spif_blind_prog(false),
+	_spif_filename(filename)
 {}
 
+int SPIInterface::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	for (auto &x : xfers) {
+		int ret = spi_put(x.cmd, const_cast<uint8_t *>(x.tx), x.rx, x.len);
+		if (ret != 0)
+			return ret;
+	}
+	return 0;
+}
+
 /* spiFlash generic acces */
 bool SPIInterface::protect_flash(uint32_t len)
 {
@@ -107,6 +119,59 @@ bool SPIInterface::write(uint32_t offset, uint8_t *data, uint32_t len,
 	return ret && ret2;
 }
 
+bool SPIInterface::write(uint32_t offset, FlashSource &src,
+		bool unprotect_flash)
+{
+	bool ret = true;
+	if (!prepare_flash_access())
+		return false;
+
+	try {
+		SPIFlash flash(this, unprotect_flash, _spif_verbose);
+		flash.read_status_reg();
+		if (flash.erase_and_prog(offset, src) == -1)
+			ret = false;
+		if (_spif_verify && ret)
+			ret = flash.verify(offset, src);
+	} catch (std::exception &e) {
+		printError(e.what());
+		ret = false;
+	}
+
+	bool ret2 = post_flash_access();
+	return ret && ret2;
+}
+
+bool SPIInterface::write(uint32_t offset, ConfigBitstreamParser *bit,
+		bool unprotect_flash)
+{
+	const std::vector<ConfigBitstreamParser::data_segment_t> &segments =
+		bit->getSegments();
+	if (segments.empty())
+		return write(offset, bit->getData(), bit->getLength() / 8,
+			unprotect_flash);
+
+	bool ret = true;
+	if (!prepare_flash_access())
+		return false;
+
+	try {
+		SPIFlash flash(this, unprotect_flash, _spif_verbose);
+		flash.read_status_reg();
+		if (flash.erase_and_prog(offset, bit->getData(), segments) == -1)
+			ret = false;
+		if (_spif_verify && ret)
+			ret = flash.verify(offset, bit->getData(), segments,
+				_spif_rd_burst);
+	} catch (std::exception &e) {
+		printError(e.what());
+		ret = false;
+	}
+
+	bool ret2 = post_flash_access();
+	return ret && ret2;
+}
+
 bool SPIInterface::dump(uint32_t base_addr, uint32_t len)
 {
 	bool ret = true;
@@ -6,9 +6,24 @@
 #ifndef SRC_SPIINTERFACE_HPP_
 #define SRC_SPIINTERFACE_HPP_
 
+#include <stdint.h>
+
 #include <iostream>
 #include <vector>
 
+class ConfigBitstreamParser;
+class FlashSource;
+
+/*!
+ * \brief one SPI transaction: CS is asserted for cmd and len bytes
+ */
+typedef struct {
+	uint8_t cmd;       /**< command/opcode */
+	const uint8_t *tx; /**< bytes sent after cmd (NULL: 0x00) */
+	uint8_t *rx;       /**< bytes received after cmd (NULL: discarded) */
+	uint32_t len;      /**< number of bytes after cmd */
+} spi_xfer_t;
+
 /*!
  * \file SPIInterface.hpp
  * \class SPIInterface
@@ -23,6 +38,20 @@ class SPIInterface {
 			uint32_t rd_burst, bool verify);
 	virtual ~SPIInterface() {}
 
+	/*!
+	 * \brief select SPI flash write strategy (both disabled by default)
+	 * \param[in] diff_prog: read flash first and only erase/program
+	 *            modified areas
+	 * \param[in] blind_prog: program pages without status polling,
+	 *            using max page program time (JTAG bridges)
+	 */
+	void set_flash_mode(bool diff_prog, bool blind_prog) {
+		_spif_diff_prog = diff_prog;
+		_spif_blind_prog = blind_prog;
+	}
+	bool flash_diff_prog() const { return _spif_diff_prog; }
+	bool flash_blind_prog() const { return _spif_blind_prog; }
+
 	bool protect_flash(uint32_t len);
 	bool unprotect_flash();
 	/*!
@@ -40,6 +69,26 @@ class SPIInterface {
 	 */
 	bool write(uint32_t offset, uint8_t *data, uint32_t len,
 		bool unprotect_flash);
+	/*!
+	 * \brief write src content into flash starting at offset,
+	 *        without loading the whole content in memory
+	 * \param[in] offset: offset into flash
+	 * \param[in] src: data source
+	 * \param[in] unprotect_flash: unprotect blocks if allowed and required
+	 * \return false when something fails
+	 */
+	bool write(uint32_t offset, FlashSource &src, bool unprotect_flash);
+	/*!
+	 * \brief write parsed file content into flash starting at offset.
+	 *        When file describes populated areas (MCS/HEX), only these
+	 *        areas are erased and written
+	 * \param[in] offset: offset into flash
+	 * \param[in] bit: parsed file
+	 * \param[in] unprotect_flash: unprotect blocks if allowed and required
+	 * \return false when something fails
+	 */
+	bool write(uint32_t offset, ConfigBitstreamParser *bit,
+		bool unprotect_flash);
 	/*!
 	 * \brief read flash offset byte starting at base_addr and
 	 *        store into filename
@@ -73,6 +122,16 @@ class SPIInterface {
 	 */
 	virtual int spi_put(uint8_t *tx, uint8_t *rx, uint32_t len) = 0;
 
+	/*!
+	 * \brief send a list of transactions, each one with its own CS
+	 *        framing. rx buffers are filled when the function returns.
+	 *        Default implementation calls spi_put for each transaction,
+	 *        interfaces override it to send the batch in one stream
+	 * \param[in] xfers: transactions list
+	 * \return 0 when success
+	 */
+	virtual int spi_put_batch(const std::vector<spi_xfer_t> &xfers);
+
 	/*!
 	 * \brief wait until register content and mask match cond, or timeout
 	 * \param[in] cmd: register to read
@@ -84,6 +143,15 @@ class SPIInterface {
 	virtual int spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 			uint32_t timeout, bool verbose = false) = 0;
 
+	/*!
+	 * \brief append a delay to the command stream without waiting
+	 *        for it (ie. JTAG idle clocks), used to replace status
+	 *        polling by worst-case flash timings
+	 * \param[in] us: delay (in us)
+	 * \return false if interface can't insert delay
+	 */
+	virtual bool spi_delay(uint32_t us) {(void)us; return false;}
+
  protected:
 	/*!
 	 * \brief prepare SPI flash access
@@ -97,6 +165,8 @@ class SPIInterface {
 	uint8_t _spif_verbose;
 	uint32_t _spif_rd_burst;
 	bool _spif_verify;
+	bool _spif_diff_prog;  /**< SPIFlash diff mode */
+	bool _spif_blind_prog; /**< SPIFlash blind page program mode */
  private:
 	std::string _spif_filename;
 
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <libusb.h>
+#include <string.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "display.hpp"
+#include "usbBulkEngine.hpp"
+
+using namespace std;
+
+UsbBulkEngine::UsbBulkEngine(libusb_context *ctx,
+		libusb_device_handle *dev_handle, uint8_t write_ep, uint8_t read_ep,
+		int xfer_size, int nb_xfer, unsigned int timeout):
+		_ctx(ctx), _dev_handle(dev_handle), _write_ep(write_ep),
+		_read_ep(read_ep), _xfer_size(xfer_size), _timeout(timeout),
+		_slots(nb_xfer), _busy(0), _rx_busy(0), _error(false)
+{
+	for (auto &slot : _slots) {
+		slot.engine = this;
+		slot.busy = false;
+		slot.xfer = libusb_alloc_transfer(0);
+		if (!slot.xfer)
+			throw std::runtime_error("UsbBulkEngine: transfer allocation fails");
+		slot.xfer->buffer = new uint8_t[xfer_size];
+		slot.xfer->user_data = &slot;
+	}
+}
+
+UsbBulkEngine::~UsbBulkEngine()
+{
+	flush();
+	for (auto &slot : _slots) {
+		if (!slot.xfer)
+			continue;
+		delete[] slot.xfer->buffer;
+		slot.xfer->buffer = NULL;
+		libusb_free_transfer(slot.xfer);
+	}
+}
+
+void LIBUSB_CALL UsbBulkEngine::xfer_callback(struct libusb_transfer *xfer)
+{
+	slot_t *slot = static_cast<slot_t *>(xfer->user_data);
+	UsbBulkEngine *engine = slot->engine;
+	bool is_read = (xfer->endpoint & LIBUSB_ENDPOINT_IN) != 0;
+
+	if (xfer->status == LIBUSB_TRANSFER_CANCELLED) {
+		/* cancelled by flush after a previous failure */
+		engine->_error = true;
+	} else if (xfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		printError("UsbBulkEngine: " + std::string((is_read) ? "read" : "write") +
+			" transfer fails: " + std::string(libusb_error_name(xfer->status)));
+		engine->_error = true;
+	} else if (is_read && xfer->actual_length == 0) {
+		/* nothing received yet: ask again */
+		if (libusb_submit_transfer(xfer) == 0)
+			return;
+		engine->_error = true;
+	} else if (!is_read && xfer->actual_length != xfer->length) {
+		printError("UsbBulkEngine: short write");
+		engine->_error = true;
+	} else if (is_read && slot->cb) {
+		if (!slot->cb(xfer->buffer, xfer->actual_length))
+			engine->_error = true;
+	}
+
+	slot->cb = nullptr;
+	slot->busy = false;
+	engine->_busy--;
+	if (is_read)
+		engine->_rx_busy--;
+}
+
+int UsbBulkEngine::handle_events()
+{
+	struct timeval tv = {0, 100000};
+	int ret = libusb_handle_events_timeout_completed(_ctx, &tv, NULL);
+	if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+		printError("UsbBulkEngine: " + std::string(libusb_error_name(ret)));
+		return -1;
+	}
+	return 0;
+}
+
+UsbBulkEngine::slot_t *UsbBulkEngine::get_slot()
+{
+	while (true) {
+		for (auto &slot : _slots)
+			if (!slot.busy)
+				return &slot;
+		/* all transfers in flight: wait for the oldest */
+		if (handle_events() < 0)
+			return NULL;
+	}
+}
+
+int UsbBulkEngine::submit(slot_t *slot, uint8_t ep, int len)
+{
+	libusb_fill_bulk_transfer(slot->xfer, _dev_handle, ep,
+		slot->xfer->buffer, len, xfer_callback, slot, _timeout);
+	int ret = libusb_submit_transfer(slot->xfer);
+	if (ret < 0) {
+		printError("UsbBulkEngine: submit fails: " +
+			std::string(libusb_error_name(ret)));
+		slot->cb = nullptr;
+		_error = true;
+		return -1;
+	}
+	slot->busy = true;
+	_busy++;
+	if (ep == _read_ep)
+		_rx_busy++;
+	return len;
+}
+
+int UsbBulkEngine::write(const uint8_t *buff, int len)
+{
+	if (len > _xfer_size) {
+		printError("UsbBulkEngine: write larger than transfer size");
+		return -1;
+	}
+	slot_t *slot = get_slot();
+	if (!slot || _error)
+		return -1;
+	memcpy(slot->xfer->buffer, buff, len);
+	return submit(slot, _write_ep, len);
+}
+
+int UsbBulkEngine::read(int len, rx_cb_t cb)
+{
+	if (len > _xfer_size) {
+		printError("UsbBulkEngine: read larger than transfer size");
+		return -1;
+	}
+	/* an empty packet submits the previous read again, after this
+	 * one: wait for it to keep rx in order
+	 */
+	while (_rx_busy > 0 && !_error)
+		if (handle_events() < 0)
+			return -1;
+	slot_t *slot = get_slot();
+	if (!slot || _error)
+		return -1;
+	slot->cb = cb;
+	return submit(slot, _read_ep, len);
+}
+
+int UsbBulkEngine::flush()
+{
+	bool cancel = false;
+	while (_busy > 0) {
+		/* a transfer fails: others are no more relevant */
+		if (_error && !cancel) {
+			for (auto &slot : _slots)
+				if (slot.busy)
+					libusb_cancel_transfer(slot.xfer);
+			cancel = true;
+		}
+		if (handle_events() < 0)
+			return -1;
+	}
+
+	int ret = (_error) ? -1 : 0;
+	_error = false;
+	return ret;
+}
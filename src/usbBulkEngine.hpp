@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef SRC_USBBULKENGINE_HPP_
+#define SRC_USBBULKENGINE_HPP_
+
+#include <libusb.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+/*!
+ * \file usbBulkEngine.hpp
+ * \class UsbBulkEngine
+ * \brief asynchronous bulk transfers using a ring of pre-allocated
+ *        libusb transfers: write() and read() only queue a transfer
+ *        and return, blocking only when all transfers are in flight,
+ *        so the endpoints stay busy during long shifts.
+ *        Transfers on an endpoint complete in submit order. Only one
+ *        IN transfer is in flight: an empty packet submits it again,
+ *        behind any later read, which would receive its data.
+ * \author agent
+ */
+class UsbBulkEngine {
+	public:
+		/*!
+		 * \brief read completion handler
+		 * \param[in] data: received bytes
+		 * \param[in] len: number of received bytes
+		 * \return false when received bytes are not valid: transfer
+		 *         is reported as failed by flush()
+		 */
+		typedef std::function<bool(const uint8_t *data, int len)> rx_cb_t;
+
+		/*!
+		 * \brief constructor
+		 * \param[in] ctx: libusb context used to handle events
+		 * \param[in] dev_handle: device handle (interface already claimed)
+		 * \param[in] write_ep: OUT endpoint
+		 * \param[in] read_ep: IN endpoint
+		 * \param[in] xfer_size: max transfer size (in byte)
+		 * \param[in] nb_xfer: number of transfers in the ring
+		 * \param[in] timeout: transfer timeout (ms)
+		 */
+		UsbBulkEngine(libusb_context *ctx, libusb_device_handle *dev_handle,
+				uint8_t write_ep, uint8_t read_ep, int xfer_size,
+				int nb_xfer = 8, unsigned int timeout = 1000);
+		~UsbBulkEngine();
+
+		/*!
+		 * \brief queue an OUT transfer (buff is copied)
+		 * \param[in] buff: buffer to write
+		 * \param[in] len: buffer length (<= xfer_size)
+		 * \return -1 when a transfer fails, len otherwise
+		 */
+		int write(const uint8_t *buff, int len);
+		/*!
+		 * \brief queue an IN transfer, after previous one is done.
+		 *        Empty packets are ignored and transfer is submitted again
+		 * \param[in] len: number of bytes to read (<= xfer_size)
+		 * \param[in] cb: called with received bytes (may be empty)
+		 * \return -1 when a transfer fails, len otherwise
+		 */
+		int read(int len, rx_cb_t cb = nullptr);
+		/*!
+		 * \brief wait until all queued transfers are done
+		 * \return -1 when a transfer fails, 0 otherwise
+		 */
+		int flush();
+
+	private:
+		typedef struct {
+			struct libusb_transfer *xfer;
+			UsbBulkEngine *engine;
+			rx_cb_t cb;
+			bool busy;
+		} slot_t;
+
+		static void LIBUSB_CALL xfer_callback(struct libusb_transfer *xfer);
+		/*!
+		 * \brief return an idle slot, handle events until one is
+		 *        available
+		 */
+		slot_t *get_slot();
+		int submit(slot_t *slot, uint8_t ep, int len);
+		int handle_events();
+
+		libusb_context *_ctx;
+		libusb_device_handle *_dev_handle;
+		uint8_t _write_ep;
+		uint8_t _read_ep;
+		int _xfer_size;
+		unsigned int _timeout;
+		std::vector<slot_t> _slots;
+		int _busy;    /*!< number of submitted transfers */
+		int _rx_busy; /*!< number of submitted IN transfers */
+		bool _error;  /*!< a transfer failed since last flush */
+};
+#endif  // SRC_USBBULKENGINE_HPP_
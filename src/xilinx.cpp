@@ -14,6 +14,7 @@
 #include "jtag.hpp"
 #include "bitparser.hpp"
 #include "configBitstreamParser.hpp"
+#include "flashSource.hpp"
 #include "jedParser.hpp"
 #include "mcsParser.hpp"
 #include "spiFlash.hpp"
@@ -239,7 +240,8 @@ void Xilinx::program(unsigned int offset, bool unprotect_flash)
 		JedParser *jed;
 		printInfo("Open file ", false);
 
-		jed = new JedParser(_filename, _verbose);
+		/* xc2c fuses are mapped with ASCII fuses list */
+		jed = new JedParser(_filename, _verbose, _fpga_family == XC2C_FAMILY);
 		if (jed->parse() == EXIT_FAILURE) {
 			printError("FAIL");
 			return;
@@ -263,10 +265,31 @@ void Xilinx::program(unsigned int offset, bool unprotect_flash)
 	if (_mode == Device::MEM_MODE || _fpga_family == XCF_FAMILY)
 		reverse = true;
 
+	/* raw file written to SPI flash: streamed without loading
+	 * whole content in memory
+	 */
+	if (_mode == Device::SPI_MODE && _fpga_family != XCF_FAMILY &&
+			!_filename.empty() && _file_extension != "bit" &&
+			_file_extension != "mcs") {
+		FileFlashSource *src;
+		printInfo("Open file ", false);
+		try {
+			src = new FileFlashSource(_filename);
+		} catch (std::exception &e) {
+			printError("FAIL");
+			return;
+		}
+		printSuccess("DONE");
+		SPIInterface::write(offset, *src, unprotect_flash);
+		delete src;
+		return;
+	}
+
 	printInfo("Open file ", false);
 	try {
 		if (_file_extension == "bit")
-			bit = new BitParser(_filename, reverse, _verbose);
+			bit = new BitParser(_filename, reverse, _verbose,
+				_mode == Device::MEM_MODE && _fpga_family != XCF_FAMILY);
 		else if (_file_extension == "mcs")
 			bit = new McsParser(_filename, reverse, _verbose);
 		else
@@ -319,7 +342,7 @@ bool Xilinx::load_bridge()
 
 	/* first: load spi over jtag */
 	try {
-		BitParser bridge(bitname, true, _verbose);
+		BitParser bridge(bitname, true, _verbose, true);
 		bridge.parse();
 		program_mem(&bridge);
 	} catch (std::exception &e) {
@@ -332,9 +355,7 @@ bool Xilinx::load_bridge()
 void Xilinx::program_spi(ConfigBitstreamParser * bit, unsigned int offset,
 		bool unprotect_flash)
 {
-	uint8_t *data = bit->getData();
-	int length = bit->getLength() / 8;
-	SPIInterface::write(offset, data, length, unprotect_flash);
+	SPIInterface::write(offset, bit, unprotect_flash);
 }
 
 void Xilinx::program_mem(ConfigBitstreamParser *bitfile)
@@ -392,7 +413,6 @@ void Xilinx::program_mem(ConfigBitstreamParser *bitfile)
 	 */
 	/* GGM: TODO */
 	int byte_length = bitfile->getLength() / 8;
-	uint8_t *data = bitfile->getData();
 	int tx_len, tx_end;
 	int burst_len = byte_length / 100;
 
@@ -412,7 +432,17 @@ void Xilinx::program_mem(ConfigBitstreamParser *bitfile)
 	         */
 			tx_end = Jtag::SHIFT_DR;
 		}
-		_jtag->shiftDR(data+i, NULL, tx_len, tx_end);
+		/* streamed bitstream: next burst is decompressed while
+		 * this one is sent
+		 */
+		uint8_t *data = bitfile->nextData(tx_len / 8);
+		if (!data) {
+			progress.fail();
+			printError("Error: fail to read bitstream");
+			_jtag->go_test_logic_reset();
+			return;
+		}
+		_jtag->shiftDR(data, NULL, tx_len, tx_end);
 		_jtag->flush();
 		progress.display(i);
 	}
@@ -563,7 +593,7 @@ bool Xilinx::flow_program(JedParser *jed)
 			uint8_t mode = (ii == 14) ? 0x3 : 0x1;
 			int id = i * 15 + ii;
 
-			memcpy(wr_buf, jed->data_for_section(id)[0].c_str(),
+			memcpy(wr_buf, jed->data_for_section(id).row(0),
 					_xc95_line_len);
 			wr_buf[_xc95_line_len] = (uint8_t) addr2&0xff;
 			wr_buf[_xc95_line_len+ 1 ] = (uint8_t)((addr2 >> 8) & 0xff);
@@ -609,9 +639,9 @@ bool Xilinx::flow_program(JedParser *jed)
 		for (size_t section = 0; section < 108; section++) {
 			for (size_t subsection = 0; subsection < 15; subsection++) {
 				int id = section * 15 + subsection;
-				std::string content = jed->data_for_section(id)[0];
+				const uint8_t *content = jed->data_for_section(id).row(0);
 				for (int col = 0; col < _xc95_line_len; col++, flash_pos++) {
-					if ((uint8_t)content[col] != (uint8_t)flash[flash_pos]) {
+					if (content[col] != (uint8_t)flash[flash_pos]) {
 						char error[256];
 						progress2.fail();
 						snprintf(error, sizeof(error),
@@ -1187,31 +1217,28 @@ bool Xilinx::xc2c_flow_program(JedParser *jed)
  * len  : number of byte to send/receive (cmd not comprise)
  *        so to send only a cmd set len to 0 (or omit this param)
  */
-int Xilinx::spi_put(uint8_t cmd,
-			uint8_t *tx, uint8_t *rx, uint32_t len)
+int Xilinx::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	int xfer_len = len + 1 + ((rx == NULL) ? 0 : 1);
-	uint8_t jtx[xfer_len];
-	jtx[0] = McsParser::reverseByte(cmd);
-	/* uint8_t jtx[xfer_len] = {McsParser::reverseByte(cmd)}; */
-	uint8_t jrx[xfer_len];
-	if (tx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i+1] = McsParser::reverseByte(tx[i]);
-	}
-	/* addr BSCAN user1 */
-	_jtag->shiftIR(USER1, 6);
-	/* send first already stored cmd,
-	 * in the same time store each byte
-	 * to next
-	 */
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
+	return spi_put_batch({{cmd, tx, rx, len}});
+}
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = McsParser::reverseByte(jrx[i+1] >> 1) | (jrx[i+2] & 0x01);
-	}
-	return 0;
+int Xilinx::spi_put_batch(const std::vector<spi_xfer_t> &xfers)
+{
+	return _jtag->spi_put_batch(xfers,
+		[&](const spi_xfer_t &x, uint8_t *rx) {
+			int xfer_len = x.len + 1 + ((rx == NULL) ? 0 : 1);
+			std::vector<uint8_t> jtx(xfer_len);
+			jtx[0] = McsParser::reverseByte(x.cmd);
+			if (x.tx != NULL)
+				McsParser::reverseBytes(x.tx, &jtx[1], x.len);
+			/* addr BSCAN user1 */
+			_jtag->shiftIR(USER1, 6);
+			/* send first already stored cmd,
+			 * in the same time store each byte
+			 * to next
+			 */
+			_jtag->shiftDR(jtx.data(), rx, 8*xfer_len);
+		});
 }
 
 int Xilinx::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
@@ -1219,10 +1246,8 @@ int Xilinx::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	int xfer_len = len + ((rx == NULL) ? 0 : 1);
 	uint8_t jtx[xfer_len];
 	uint8_t jrx[xfer_len];
-	if (tx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i] = McsParser::reverseByte(tx[i]);
-	}
+	if (tx != NULL)
+		McsParser::reverseBytes(tx, jtx, len);
 	/* addr BSCAN user1 */
 	_jtag->shiftIR(USER1, 6);
 	/* send first already stored cmd,
@@ -1231,13 +1256,18 @@ int Xilinx::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	 */
 	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = McsParser::reverseByte(jrx[i] >> 1) | (jrx[i+1] & 0x01);
-	}
+	if (rx != NULL)
+		McsParser::reverseShiftedBytes(jrx, rx, len);
 	return 0;
 }
 
+/* flash works while JTAG stays in idle: clocks are only sent */
+bool Xilinx::spi_delay(uint32_t us)
+{
+	_jtag->toggleClk_us(us);
+	return true;
+}
+
 int Xilinx::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 			uint32_t timeout, bool verbose)
 {
@@ -1246,22 +1276,39 @@ int Xilinx::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 	uint8_t tmp;
 	uint8_t tx = McsParser::reverseByte(cmd);
 	uint32_t count = 0;
+	/* status is read by batches: one round trip for many
+	 * reads (flash keeps sending status register)
+	 */
+	const int batch_size = 8;
+	int handles[batch_size];
 
 	_jtag->shiftIR(USER1, 6, Jtag::UPDATE_IR);
 	_jtag->shiftDR(&tx, NULL, 8, Jtag::SHIFT_DR);
 
 	do {
-		_jtag->shiftDR(dummy, rx, 8*2, Jtag::SHIFT_DR);
-		tmp = (McsParser::reverseByte(rx[0]>>1)) | (0x01 & rx[1]);
-		count++;
-		if (count == timeout){
-			printf("timeout: %x %x %x\n", tmp, rx[0], rx[1]);
-			break;
+		_jtag->queue_begin();
+		for (int i = 0; i < batch_size; i++)
+			handles[i] = _jtag->queue_shiftDR(dummy, 8*2, Jtag::SHIFT_DR);
+		if (_jtag->queue_flush() != 0) {
+			printError("spi_wait: read failure");
+			_jtag->go_test_logic_reset();
+			return -1;
 		}
-		if (verbose) {
-			printf("%x %x %x %u\n", tmp, mask, cond, count);
+		for (int i = 0; i < batch_size; i++) {
+			const uint8_t *jrx = _jtag->queue_tdo(handles[i]);
+			tmp = (McsParser::reverseByte(jrx[0]>>1)) | (0x01 & jrx[1]);
+			count++;
+			if (count == timeout){
+				printf("timeout: %x %x %x\n", tmp, jrx[0], jrx[1]);
+				break;
+			}
+			if (verbose) {
+				printf("%x %x %x %u\n", tmp, mask, cond, count);
+			}
+			if ((tmp & mask) == cond)
+				break;
 		}
-	} while ((tmp & mask) != cond);
+	} while ((tmp & mask) != cond && count != timeout);
 	_jtag->shiftDR(dummy, rx, 8*2, Jtag::EXIT1_DR);
 	_jtag->go_test_logic_reset();
 
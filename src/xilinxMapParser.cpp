@@ -99,7 +99,7 @@ int XilinxMapParser::parse()
  */
 bool XilinxMapParser::jedApplyMap()
 {
-	std::string listfuse = _jed->get_fuselist();
+	const std::string &listfuse = _jed->get_fuselist();
 	std::string tmp;
 	int row = 0;
 
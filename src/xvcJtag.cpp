@@ -16,9 +16,11 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <map>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -27,54 +29,219 @@
 
 using namespace std;
 
-XvcJtag::XvcJtag(uint32_t clkHZ, bool verbose)
-	: _verbose(verbose), _client_fd(0), _curr_tms(0)
+static int sread(int fd, void *data, size_t len)
 {
-	int ret;
-	struct sockaddr_in serv_addr;
-	struct hostent *server;
+	while (len > 0)
+	{
+		int ret = read(fd, data, len);
+		if (ret <= 0)
+			return ret;
+		data = (uint8_t *)data + ret;
+		len -= ret;
+	}
+	return 1;
+}
 
-	_client_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (_client_fd < 0)
+static int swrite(int fd, const void *data, size_t len)
+{
+	while (len > 0)
 	{
-		perror("socket");
-		throw std::exception();
+		int ret = write(fd, data, len);
+		if (ret <= 0)
+			return ret;
+		data = (uint8_t *)data + ret;
+		len -= ret;
 	}
+	return 1;
+}
 
-	bzero((char *)&serv_addr, sizeof(serv_addr));
-	server = gethostbyname("192.168.1.112");
-	if (server == NULL)
+/* write all iovec content (one syscall in most cases) */
+static int swritev(int fd, struct iovec *iov, int iovcnt)
+{
+	while (iovcnt > 0)
 	{
-		cerr << "Failed finding server name" << std::endl;
-		throw std::exception();
+		ssize_t ret = writev(fd, iov, iovcnt);
+		if (ret <= 0)
+			return ret;
+		while (iovcnt > 0 && (size_t)ret >= iov->iov_len)
+		{
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0)
+		{
+			iov->iov_base = (uint8_t *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
 	}
+	return 1;
+}
 
-	serv_addr.sin_family = AF_INET;
-	memcpy((char *)&(serv_addr.sin_addr.s_addr), (char *)(server->h_addr),
-		   server->h_length);
-	serv_addr.sin_port = htons(2542);
-	if (connect(_client_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) <
-		0)
+/* copy len bits from src to dst starting at bit dst_off (LSB first).
+ * bits after dst_off in dst must be zero: unused bits stay cleared
+ */
+static void copy_bits(uint8_t *dst, uint32_t dst_off, const uint8_t *src,
+	uint32_t len)
+{
+	uint8_t shift = dst_off & 0x07;
+	uint32_t nb_byte = len >> 3;
+	uint8_t rest = len & 0x07;
+	uint8_t rest_mask = (1 << rest) - 1;
+	dst += dst_off >> 3;
+
+	if (shift == 0)
 	{
-		cerr << "Failed to connect to server" << std::endl;
-		throw std::exception();
+		memcpy(dst, src, nb_byte);
+		if (rest)
+			dst[nb_byte] = src[nb_byte] & rest_mask;
+		return;
+	}
+
+	uint8_t keep = dst[0] & ((1 << shift) - 1);
+	for (uint32_t i = 0; i < nb_byte; i++)
+	{
+		dst[i] = keep | (src[i] << shift);
+		keep = src[i] >> (8 - shift);
+	}
+	uint16_t val = keep;
+	if (rest)
+		val |= (src[nb_byte] & rest_mask) << shift;
+	dst[nb_byte] = val & 0xff;
+	if (shift + rest > 8)
+		dst[nb_byte + 1] = val >> 8;
+}
+
+/* set len bits, starting at bit dst_off, to val (LSB first) */
+static void fill_bits(uint8_t *dst, uint32_t dst_off, uint8_t val,
+	uint32_t len)
+{
+	while (len > 0)
+	{
+		uint8_t shift = dst_off & 0x07;
+		uint8_t *ptr = dst + (dst_off >> 3);
+		if (shift == 0 && len >= 8)
+		{
+			uint32_t nb_byte = len >> 3;
+			memset(ptr, (val) ? 0xff : 0x00, nb_byte);
+			dst_off += nb_byte * 8;
+			len -= nb_byte * 8;
+			continue;
+		}
+		uint8_t nb_bit = std::min((uint32_t)(8 - shift), len);
+		uint8_t mask = ((1 << nb_bit) - 1) << shift;
+		if (shift == 0)
+			*ptr = 0;
+		if (val)
+			*ptr |= mask;
+		dst_off += nb_bit;
+		len -= nb_bit;
+	}
+}
+
+XvcJtag::XvcJtag(const string &ip_adr, uint32_t port, uint32_t clkHZ,
+		bool verbose)
+	: _verbose(verbose), _client_fd(-1), _vector_len(1024),
+	  _max_inflight(65536), _inflight(0), _tx_bits(0)
+{
+	struct addrinfo hints, *res, *rp;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	int ret = getaddrinfo(ip_adr.c_str(), std::to_string(port).c_str(),
+		&hints, &res);
+	if (ret != 0)
+	{
+		throw std::runtime_error("Failed finding server name " + ip_adr +
+			": " + gai_strerror(ret));
+	}
+
+	for (rp = res; rp != NULL; rp = rp->ai_next)
+	{
+		_client_fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (_client_fd < 0)
+			continue;
+		if (connect(_client_fd, rp->ai_addr, rp->ai_addrlen) == 0)
+			break;
+		close(_client_fd);
+		_client_fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (_client_fd < 0)
+	{
+		throw std::runtime_error("Failed to connect to server " + ip_adr +
+			":" + std::to_string(port));
 	}
 
 	int yes = 1;
 	if (setsockopt(_client_fd, IPPROTO_TCP, TCP_NODELAY, (char *)&yes, sizeof(int)) <
 		0)
 	{
-		cerr << "Failed to set nodelay" << std::endl;
-		throw std::exception();
+		close(_client_fd);
+		throw std::runtime_error("Failed to set nodelay");
+	}
+
+	/* pending replies must fit in receive buffer: server is never
+	 * blocked writing replies and always reads next commands.
+	 * SO_RCVBUF includes kernel bookkeeping overhead (on Linux value
+	 * is doubled): only a quarter is used for replies
+	 */
+	int rcvbuf;
+	socklen_t optlen = sizeof(rcvbuf);
+	if (getsockopt(_client_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen) == 0 &&
+		rcvbuf / 4 > 0)
+		_max_inflight = rcvbuf / 4;
+
+	/* server info: xvcServer_v1.0:<max vector len>\n */
+	char info[64];
+	size_t info_len = 0;
+	if (swrite(_client_fd, "getinfo:", 8) <= 0)
+	{
+		close(_client_fd);
+		throw std::runtime_error("Failed to send getinfo");
+	}
+	while (info_len < sizeof(info) - 1)
+	{
+		if (sread(_client_fd, &info[info_len], 1) <= 0)
+		{
+			close(_client_fd);
+			throw std::runtime_error("Failed to read getinfo reply");
+		}
+		if (info[info_len] == '\n')
+			break;
+		info_len++;
 	}
+	info[info_len] = '\0';
+
+	/* max vector length covers TMS and TDI vectors together
+	 * (reference server rejects nr_bytes * 2 > buffer size)
+	 */
+	unsigned int vector_len;
+	if (sscanf(info, "xvcServer_v%*[^:]:%u", &vector_len) == 1 &&
+		vector_len > 1)
+		_vector_len = std::min((size_t)vector_len / 2, BUFFER_SIZE);
+	else
+		printWarn("XVC: unknown server info " + string(info));
+
+	if (_verbose)
+		printInfo(string(info) + " -> vector length " +
+			std::to_string(_vector_len));
+
+	setClkFreq(clkHZ);
 }
 
-XvcJtag::~XvcJtag() { close(_client_fd); }
+XvcJtag::~XvcJtag()
+{
+	flush();
+	read_all_replies();
+	close(_client_fd);
+}
 
 int XvcJtag::setClkFreq(uint32_t clkHZ)
 {
-	int actual_length;
-	int ret, req_freq = clkHZ;
+	int req_freq = clkHZ;
 
 	_clkHZ = clkHZ;
 
@@ -84,20 +251,17 @@ int XvcJtag::setClkFreq(uint32_t clkHZ)
 	return clkHZ;
 }
 
-int XvcJtag::writeTMS(uint8_t *tms, int len, bool flush_buffer)
+int XvcJtag::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 {
 	int ret;
 
 	if (_verbose)
-		printf("writeTMS len %d flush %d\n", len, flush_buffer);
+		printf("writeTMS len %u flush %d\n", len, flush_buffer);
 
-	/* fill buffer to reduce USB transaction */
-	for (int i = 0; i < len; i++)
-	{
-		ret = append_step(tms[i >> 3] & (1 << (i & 0x07)), 1);
-		if (ret < 0)
-			return ret;
-	}
+	/* fill buffer to reduce network transaction */
+	ret = append_bits(tms, 0, NULL, 1, len);
+	if (ret < 0)
+		return ret;
 
 	/* try to flush buffer */
 	if (flush_buffer)
@@ -115,12 +279,11 @@ int XvcJtag::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	if (_verbose)
 		printf("toggleClk tms %d tdi %d len %d\n", tms, tdi, clk_len);
 
-	for (uint32_t i = 0; i < clk_len; i++)
-	{
-		append_step(tms, tdi);
-	}
+	int ret = append_bits(NULL, tms, NULL, tdi, clk_len);
+	if (ret < 0)
+		return ret;
 
-	int ret = flush();
+	ret = flush();
 	if (ret < 0)
 		return ret;
 
@@ -133,140 +296,164 @@ int XvcJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 {
 	int ret;
 	uint32_t pos = 0;
+	uint32_t max_bits = _vector_len * 8;
 
 	if (_verbose)
 		printf("writeTDI len %d end %d\n", len, end);
 
+	/* TDO starts at bit 0 of a vector */
 	ret = flush();
 	if (ret < 0)
 		return ret;
 
 	while (pos < len)
 	{
-		uint32_t tx_size = std::min(len - pos, (uint32_t)get_buffer_size() * 8);
-		for (uint32_t i = 0; i < tx_size; i++)
+		uint32_t tx_size = std::min(len - pos, max_bits);
+		bool last = end && (pos + tx_size == len);
+		/* TMS low, high with the last bit */
+		ret = append_bits(NULL, 0, (tx) ? tx + (pos / 8) : NULL, 0,
+			(last) ? tx_size - 1 : tx_size);
+		if (ret < 0)
+			return ret;
+		if (last)
 		{
-			if (end && (pos + i == len - 1))
-				_curr_tms = 1;
-			ret = append_step(_curr_tms, tx[(pos + i) >> 3] & (1 << (i & 0x07)));
+			uint32_t bit = len - 1;
+			ret = append_bits(NULL, 1, NULL,
+				(tx) ? tx[bit >> 3] & (1 << (bit & 0x07)) : 0, 1);
 			if (ret < 0)
 				return ret;
 		}
-		if (rx != nullptr)
-			ret = write_buffer(rx + (pos / 8));
-		else
-			ret = flush();
+		ret = write_buffer((rx) ? rx + (pos / 8) : NULL);
 		if (ret < 0)
 			return ret;
 		pos += tx_size;
 	}
 
+	/* rx must be filled before return */
+	if (rx && read_all_replies() <= 0)
+		return -1;
+
 	return len;
 }
 
-static int sread(int fd, void *data, size_t len)
+int XvcJtag::append_bits(const uint8_t *tms, uint8_t tms_val,
+	const uint8_t *tdi, uint8_t tdi_val, uint32_t len)
 {
 	while (len > 0)
 	{
-		int ret = read(fd, data, len);
-		if (ret <= 0)
-			return ret;
-		data = (uint8_t *)data + ret;
-		len -= ret;
-	}
-	return 1;
-}
+		uint32_t xfer = std::min((uint32_t)(_vector_len * 8 - _tx_bits), len);
+		/* vector too small for all bits: cut on a byte boundary
+		 * to keep source aligned
+		 */
+		if (xfer < len)
+			xfer &= ~0x07;
+		if (xfer == 0)
+		{
+			int ret = flush();
+			if (ret < 0)
+				return ret;
+			continue;
+		}
 
-static int swrite(int fd, const void *data, size_t len)
-{
-	while (len > 0)
-	{
-		int ret = write(fd, data, len);
-		if (ret <= 0)
-			return ret;
-		data = (uint8_t *)data + ret;
-		len -= ret;
+		if (tms)
+			copy_bits(_tms_buffer, _tx_bits, tms, xfer);
+		else
+			fill_bits(_tms_buffer, _tx_bits, tms_val, xfer);
+		if (tdi)
+			copy_bits(_tdi_buffer, _tx_bits, tdi, xfer);
+		else
+			fill_bits(_tdi_buffer, _tx_bits, tdi_val, xfer);
+
+		_tx_bits += xfer;
+		len -= xfer;
+		if (tms)
+			tms += xfer >> 3;
+		if (tdi)
+			tdi += xfer >> 3;
 	}
-	return 1;
+	return 0;
 }
 
 int XvcJtag::write_buffer(uint8_t *tdo)
 {
 	int ret = 0;
-	int actual_length;
 
 	if (_tx_bits == 0)
 		return 0;
 
 	int byte_len = (_tx_bits + 7) / 8;
-	uint32_t bit_len = _tx_bits;
-
-	ret = swrite(_client_fd, "shift:", 6);
-	if (ret <= 0) return ret;
-
-	ret = swrite(_client_fd, &bit_len, 4);
-	if (ret <= 0) return ret;
-
-	ret = swrite(_client_fd, _tms_buffer, byte_len);
-	if (ret <= 0) return ret;
-
-	ret = swrite(_client_fd, _tdi_buffer, byte_len);
-	if (ret <= 0) return ret;
-
-	ret = sread(_client_fd, _tdo_buffer, byte_len);
-	if (ret <= 0) return ret;
-
-	if (tdo != nullptr)
+	uint8_t header[10] = {'s', 'h', 'i', 'f', 't', ':',
+		static_cast<uint8_t>(_tx_bits & 0xff),
+		static_cast<uint8_t>((_tx_bits >> 8) & 0xff),
+		static_cast<uint8_t>((_tx_bits >> 16) & 0xff),
+		static_cast<uint8_t>((_tx_bits >> 24) & 0xff)};
+
+	/* too many pending replies: read oldest */
+	while (!_replies.empty() && _inflight + byte_len > _max_inflight)
 	{
-		memcpy(tdo, _tdo_buffer, byte_len);
+		ret = read_reply();
+		if (ret <= 0)
+			return -1;
+	}
 
-		if (_verbose)
-		{
-			printf("TDO = ");
-			for (int i = 0; i < _tx_bits; i++)
-			{
-				printf("%d", (tdo[i >> 3] & (1 << (i & 0x07))) != 0);
-			}
-			printf("\n");
-		}
+	struct iovec iov[3] = {
+		{header, sizeof(header)},
+		{_tms_buffer, (size_t)byte_len},
+		{_tdi_buffer, (size_t)byte_len}
+	};
+	ret = swritev(_client_fd, iov, 3);
+	if (ret <= 0)
+	{
+		printError("XVC: shift command failed");
+		return -1;
 	}
 
+	_replies.push_back({tdo, byte_len});
+	_inflight += byte_len;
+
 	ret = _tx_bits;
 	_tx_bits = 0;
 
 	return ret;
 }
 
-int XvcJtag::append_step(uint8_t tms, uint8_t tdi)
+int XvcJtag::read_reply()
 {
-	int ret = 0;
+	xvc_reply_t reply = _replies.front();
+	_replies.pop_front();
+	_inflight -= reply.len;
 
-	_curr_tms = tms;
-	unsigned char _tms = tms ? 1 : 0;
-	unsigned char _tdi = tdi ? 1 : 0;
-
-	if (isFull())
+	uint8_t *tdo = (reply.tdo) ? reply.tdo : _tdo_buffer;
+	int ret = sread(_client_fd, tdo, reply.len);
+	if (ret <= 0)
 	{
-		ret = flush();
-		if (ret < 0)
-			return ret;
+		printError("XVC: failed to read shift reply");
+		return ret;
 	}
 
-	if (_verbose)
-		printf("TMS = %d TDI = %d\n", _tms, _tdi);
-
-	int byte_index = _tx_bits / 8;
-	int bit_index = _tx_bits % 8;
-
-	if (bit_index == 0)
+	if (_verbose && reply.tdo)
 	{
-		_tms_buffer[byte_index] = 0;
-		_tdi_buffer[byte_index] = 0;
+		printf("TDO = ");
+		for (int i = 0; i < reply.len * 8; i++)
+		{
+			printf("%d", (tdo[i >> 3] & (1 << (i & 0x07))) != 0);
+		}
+		printf("\n");
 	}
 
-	_tms_buffer[byte_index] |= _tms << bit_index;
-	_tdi_buffer[byte_index] |= _tdi << bit_index;
-	_tx_bits++;
-
 	return ret;
 }
+
+int XvcJtag::read_all_replies()
+{
+	while (!_replies.empty())
+	{
+		if (read_reply() <= 0)
+		{
+			_replies.clear();
+			_inflight = 0;
+			return -1;
+		}
+	}
+	return 1;
+}
@@ -3,49 +3,98 @@
 #ifndef SRC_XVC_JTAG_HPP_
 #define SRC_XVC_JTAG_HPP_
 
+#include <deque>
+#include <string>
+
 #include "jtagInterface.hpp"
 
 /*!
  * \file XvcJtag.hpp
  * \class XvcJtag
- * \brief concrete class between jtag implementation and FTDI capable bitbang
- * mode \author Gwenhael Goavec-Merou
+ * \brief concrete class between jtag implementation and a Xilinx Virtual
+ * Cable (XVC) server. shift: commands are pipelined: replies are read
+ * only when TDO is required or when enough replies are pending to fill
+ * socket receive buffer.
+ * \author Gwenhael Goavec-Merou
  */
 
 class XvcJtag : public JtagInterface
 {
 public:
-	XvcJtag(uint32_t clkHZ, bool verbose);
+	/*!
+	 * \brief connect to XVC server and read its max vector length
+	 * \param[in] ip_adr: server IP address or hostname
+	 * \param[in] port: server TCP port
+	 * \param[in] clkHZ: jtag frequency
+	 * \param[in] verbose: verbose level
+	 */
+	XvcJtag(const std::string &ip_adr, uint32_t port, uint32_t clkHZ,
+		bool verbose);
 	virtual ~XvcJtag();
 
 	int setClkFreq(uint32_t clkHZ) override;
 
 	/* TMS */
-	int writeTMS(uint8_t *tms, int len, bool flush_buffer) override;
+	int writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer) override;
 	/* TDI */
 	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
 	/* clk */
 	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
 
 	/*!
-   * \brief return internal buffer size (in byte).
-   * \return _buffer_size divided by 2 (one state == 2 bits)
-   */
-	int get_buffer_size() override { return BUFFER_SIZE; }
+	 * \brief return internal buffer size (in byte).
+	 * \return max TMS (or TDI) vector length accepted by the server
+	 */
+	int get_buffer_size() override { return _vector_len; }
 
-	bool isFull() override { return _tx_bits >= BUFFER_SIZE; }
+	bool isFull() override { return _tx_bits >= _vector_len * 8; }
 
 	int flush() override;
 
 private:
 	static constexpr size_t BUFFER_SIZE = 16384;
 
-	int append_step(uint8_t tms, uint8_t tdi);
+	/*!
+	 * \brief append len TMS/TDI bits to current vector, send
+	 *        vector each time it's full.
+	 * \param[in] tms: tms bits (NULL: constant tms_val)
+	 * \param[in] tms_val: tms state when tms is NULL
+	 * \param[in] tdi: tdi bits (NULL: constant tdi_val)
+	 * \param[in] tdi_val: tdi state when tdi is NULL
+	 * \param[in] len: number of bits
+	 * \return < 0 if something wrong
+	 */
+	int append_bits(const uint8_t *tms, uint8_t tms_val,
+		const uint8_t *tdi, uint8_t tdi_val, uint32_t len);
+	/*!
+	 * \brief send current vector with shift: command
+	 * \param[in] tdo: buffer to fill with reply (NULL: discarded)
+	 * \return < 0 if something wrong, number of bits otherwise
+	 */
 	int write_buffer(uint8_t *tdo);
+	/*!
+	 * \brief read oldest pending reply
+	 * \return <= 0 if something wrong
+	 */
+	int read_reply();
+	/*!
+	 * \brief read all pending replies
+	 * \return <= 0 if something wrong
+	 */
+	int read_all_replies();
 
 	bool _verbose;
 	int _client_fd;
-	uint8_t _curr_tms;
+	int _vector_len;    /*!< max TMS/TDI vector length (in byte): half
+	                     *   of server max vector length */
+	size_t _max_inflight; /*!< max pending reply bytes */
+	size_t _inflight;   /*!< pending reply bytes */
+	/* shift: commands waiting for their reply */
+	typedef struct {
+		uint8_t *tdo;    /*!< destination (NULL: discarded) */
+		int len;         /*!< reply length (in byte) */
+	} xvc_reply_t;
+	std::deque<xvc_reply_t> _replies;
 	uint8_t _tms_buffer[BUFFER_SIZE];
 	uint8_t _tdi_buffer[BUFFER_SIZE];
 	uint8_t _tdo_buffer[BUFFER_SIZE];